@@ -48,6 +48,7 @@ MODULE_ALIAS("ecb(aes)");
 MODULE_ALIAS("cbc(aes)");
 MODULE_ALIAS("ctr(aes)");
 MODULE_ALIAS("xts(aes)");
+MODULE_ALIAS("xts-plain64(aes)");
 #endif
 
 MODULE_AUTHOR("Ard Biesheuvel <ard.biesheuvel@linaro.org>");
@@ -280,6 +281,84 @@ static int xts_decrypt(struct blkcipher_desc *desc, struct scatterlist *dst,
 	return err;
 }
 
+/*
+ * xts-plain64: XTS over a run of 512 byte sectors, as used by dm-crypt.
+ * The IV holds the little endian number of the first sector, every
+ * following sector uses the next number, so a single request can cover
+ * many sectors instead of one request per sector.
+ */
+#define XTS_SECTOR_SIZE		512
+
+static void xts_plain64_iv(u8 iv[], u64 sector)
+{
+	memset(iv, 0, AES_BLOCK_SIZE);
+	*(__le64 *)iv = cpu_to_le64(sector);
+}
+
+static int xts_plain64_encrypt(struct blkcipher_desc *desc,
+			       struct scatterlist *dst,
+			       struct scatterlist *src, unsigned int nbytes)
+{
+	struct crypto_aes_xts_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	int err, rounds = 6 + ctx->key1.key_length / 4;
+	u64 sector = le64_to_cpup((__le64 *)desc->info);
+	u8 __aligned(8) iv[AES_BLOCK_SIZE];
+	struct blkcipher_walk walk;
+	unsigned int sectors, i;
+
+	desc->flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, XTS_SECTOR_SIZE);
+
+	kernel_neon_begin();
+	while ((sectors = (walk.nbytes / XTS_SECTOR_SIZE))) {
+		for (i = 0; i < sectors; i++, sector++) {
+			xts_plain64_iv(iv, sector);
+			aes_xts_encrypt(walk.dst.virt.addr + i * XTS_SECTOR_SIZE,
+					walk.src.virt.addr + i * XTS_SECTOR_SIZE,
+					(u8 *)ctx->key1.key_enc, rounds,
+					XTS_SECTOR_SIZE / AES_BLOCK_SIZE,
+					(u8 *)ctx->key2.key_enc, iv, 1);
+		}
+		err = blkcipher_walk_done(desc, &walk, walk.nbytes % XTS_SECTOR_SIZE);
+	}
+	kernel_neon_end();
+
+	return err;
+}
+
+static int xts_plain64_decrypt(struct blkcipher_desc *desc,
+			       struct scatterlist *dst,
+			       struct scatterlist *src, unsigned int nbytes)
+{
+	struct crypto_aes_xts_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	int err, rounds = 6 + ctx->key1.key_length / 4;
+	u64 sector = le64_to_cpup((__le64 *)desc->info);
+	u8 __aligned(8) iv[AES_BLOCK_SIZE];
+	struct blkcipher_walk walk;
+	unsigned int sectors, i;
+
+	desc->flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, XTS_SECTOR_SIZE);
+
+	kernel_neon_begin();
+	while ((sectors = (walk.nbytes / XTS_SECTOR_SIZE))) {
+		for (i = 0; i < sectors; i++, sector++) {
+			xts_plain64_iv(iv, sector);
+			aes_xts_decrypt(walk.dst.virt.addr + i * XTS_SECTOR_SIZE,
+					walk.src.virt.addr + i * XTS_SECTOR_SIZE,
+					(u8 *)ctx->key1.key_dec, rounds,
+					XTS_SECTOR_SIZE / AES_BLOCK_SIZE,
+					(u8 *)ctx->key2.key_enc, iv, 1);
+		}
+		err = blkcipher_walk_done(desc, &walk, walk.nbytes % XTS_SECTOR_SIZE);
+	}
+	kernel_neon_end();
+
+	return err;
+}
+
 static struct crypto_alg aes_algs[] = { {
 	.cra_name		= "__ecb-aes-" MODE,
 	.cra_driver_name	= "__driver-ecb-aes-" MODE,
@@ -352,6 +431,24 @@ static struct crypto_alg aes_algs[] = { {
 		.encrypt	= xts_encrypt,
 		.decrypt	= xts_decrypt,
 	},
+}, {
+	.cra_name		= "__xts-plain64-aes-" MODE,
+	.cra_driver_name	= "__driver-xts-plain64-aes-" MODE,
+	.cra_priority		= 0,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct crypto_aes_xts_ctx),
+	.cra_alignmask		= 7,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_blkcipher = {
+		.min_keysize	= 2 * AES_MIN_KEY_SIZE,
+		.max_keysize	= 2 * AES_MAX_KEY_SIZE,
+		.ivsize		= AES_BLOCK_SIZE,
+		.setkey		= xts_set_key,
+		.encrypt	= xts_plain64_encrypt,
+		.decrypt	= xts_plain64_decrypt,
+	},
 }, {
 	.cra_name		= "ecb(aes)",
 	.cra_driver_name	= "ecb-aes-" MODE,
@@ -432,6 +529,26 @@ static struct crypto_alg aes_algs[] = { {
 		.encrypt	= ablk_encrypt,
 		.decrypt	= ablk_decrypt,
 	}
+}, {
+	.cra_name		= "xts-plain64(aes)",
+	.cra_driver_name	= "xts-plain64-aes-" MODE,
+	.cra_priority		= PRIO,
+	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER|CRYPTO_ALG_ASYNC,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct async_helper_ctx),
+	.cra_alignmask		= 7,
+	.cra_type		= &crypto_ablkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= ablk_init,
+	.cra_exit		= ablk_exit,
+	.cra_ablkcipher = {
+		.min_keysize	= 2 * AES_MIN_KEY_SIZE,
+		.max_keysize	= 2 * AES_MAX_KEY_SIZE,
+		.ivsize		= AES_BLOCK_SIZE,
+		.setkey		= ablk_set_key,
+		.encrypt	= ablk_encrypt,
+		.decrypt	= ablk_decrypt,
+	}
 } };
 
 static int __init aes_init(void)
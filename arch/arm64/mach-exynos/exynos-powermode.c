@@ -12,6 +12,7 @@
 #include <linux/of.h>
 #include <linux/device.h>
 #include <linux/tick.h>
+#include <linux/cpuidle.h>
 #include <linux/kobject.h>
 #include <linux/sysfs.h>
 #include <linux/stat.h>
@@ -263,8 +264,13 @@ int enter_c2(unsigned int cpu, int index, int *sub_state)
 	if (get_cluster_id(cpu))
 		goto out;
 
-	/* If cluster is not busy, enable cpu sequcner to shutdown cluster */
-	if (!is_cpus_busy(cpd_residency, cpu_coregroup_mask(cpu))) {
+	/*
+	 * If cluster is not busy, enable cpu sequcner to shutdown cluster.
+	 * The idle governor may veto it when it expects a cpu of the cluster
+	 * to wake up before the next timer event says.
+	 */
+	if (!is_cpus_busy(cpd_residency, cpu_coregroup_mask(cpu)) &&
+	    cpuidle_history_cluster_idle(cpu_coregroup_mask(cpu), cpd_residency)) {
 		exynos_cpu_sequencer_ctrl(true);
 		*sub_state |= CPD_STATE;
 		index++;
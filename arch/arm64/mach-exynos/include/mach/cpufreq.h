@@ -111,6 +111,38 @@ static inline void exynos_set_max_freq(int max_freq, unsigned int cpu) {}
 static inline void ipa_set_clamp(int cpu, unsigned int clamp_freq, unsigned int gov_target) {}
 #endif
 
+/* interfaces for governors */
+#if defined(CONFIG_ARM_EXYNOS_MP_CPUFREQ)
+unsigned int exynos_cpufreq_resolve(struct cpufreq_policy *policy,
+				    unsigned int target_freq);
+unsigned int exynos_cpufreq_transition_cost(struct cpufreq_policy *policy,
+					    unsigned int old_freq,
+					    unsigned int new_freq);
+#else
+static inline unsigned int exynos_cpufreq_transition_cost(struct cpufreq_policy *policy,
+							  unsigned int old_freq,
+							  unsigned int new_freq)
+{
+	return 0;
+}
+#endif
+
+/*
+ * A governor dropping to @new_freq holds its current frequency this many
+ * times as long as the transition takes on top of its own sample window or
+ * rate limit, so that a costly drop needs a longer stretch of low load.
+ * The product alone stays well below those windows and would never bind.
+ */
+#define EXYNOS_CPUFREQ_COST_HOLD	20
+
+static inline unsigned int exynos_cpufreq_hold_time(struct cpufreq_policy *policy,
+						    unsigned int old_freq,
+						    unsigned int new_freq)
+{
+	return EXYNOS_CPUFREQ_COST_HOLD *
+	       exynos_cpufreq_transition_cost(policy, old_freq, new_freq);
+}
+
 /* interface for THERMAL */
 extern void exynos_thermal_throttle(void);
 extern void exynos_thermal_unthrottle(void);
@@ -630,6 +630,52 @@ static struct bfq_group *bfq_alloc_root_group(struct bfq_data *bfqd, int node)
 	return bfqg;
 }
 
+/*
+ * Android moves the foreground and top-app tasks into their own groups; once
+ * userspace gives those groups a bfqio.weight of at least bfq_wr_fg_weight,
+ * their queues are weight-raised each time they become backlogged, without
+ * waiting for the interactive heuristics to detect them.
+ */
+static bool bfq_bfqq_in_fg_group(struct bfq_data *bfqd,
+				 struct bfq_queue *bfqq)
+{
+	struct bfq_group *bfqg = container_of(bfqq->entity.sched_data,
+					      struct bfq_group, sched_data);
+
+	return bfqd->bfq_wr_fg_weight &&
+	       bfqg->entity.new_weight >= bfqd->bfq_wr_fg_weight;
+}
+
+static inline u64 bfq_rq_latency_us(struct request *rq)
+{
+#ifdef CONFIG_BLK_CGROUP
+	return div_u64(sched_clock() - rq_start_time_ns(rq), NSEC_PER_USEC);
+#else
+	return jiffies_to_usecs(jiffies - rq->start_time);
+#endif
+}
+
+static void bfq_group_account_rq(struct bfq_queue *bfqq, struct request *rq)
+{
+	struct bfq_group *bfqg = container_of(bfqq->entity.sched_data,
+					      struct bfq_group, sched_data);
+	const int dir = rq_data_dir(rq);
+	u64 lat = bfq_rq_latency_us(rq);
+
+	bfqg->lat_nr[dir]++;
+	bfqg->lat_sum_us[dir] += lat;
+	if (lat > bfqg->lat_max_us[dir])
+		bfqg->lat_max_us[dir] = lat;
+}
+
+static void bfq_group_account_wr_boost(struct bfq_queue *bfqq)
+{
+	struct bfq_group *bfqg = container_of(bfqq->entity.sched_data,
+					      struct bfq_group, sched_data);
+
+	bfqg->wr_boosts++;
+}
+
 #define SHOW_FUNCTION(__VAR)						\
 static u64 bfqio_cgroup_##__VAR##_read(struct cgroup *cgroup,		\
 				       struct cftype *cftype)		\
@@ -718,6 +764,53 @@ STORE_FUNCTION(ioprio, 0, IOPRIO_BE_NR - 1);
 STORE_FUNCTION(ioprio_class, IOPRIO_CLASS_RT, IOPRIO_CLASS_IDLE);
 #undef STORE_FUNCTION
 
+/*
+ * Latency stats of the group, summed over the devices it does I/O on. The
+ * fields are updated under the queue lock of each device, so the values read
+ * here may be slightly inconsistent with each other.
+ */
+static int bfqio_cgroup_latency_read(struct cgroup *cgroup,
+				     struct cftype *cftype,
+				     struct seq_file *m)
+{
+	struct bfqio_cgroup *bgrp;
+	struct bfq_group *bfqg;
+	unsigned long nr[2] = { 0, 0 }, wr_boosts = 0;
+	u64 sum[2] = { 0, 0 }, max[2] = { 0, 0 };
+	int dir;
+
+	mutex_lock(&bfqio_mutex);
+	if (bfqio_is_removed(cgroup)) {
+		mutex_unlock(&bfqio_mutex);
+		return -ENODEV;
+	}
+
+	bgrp = cgroup_to_bfqio(cgroup);
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(bfqg, &bgrp->group_data, group_node) {
+		for (dir = READ; dir <= WRITE; dir++) {
+			nr[dir] += bfqg->lat_nr[dir];
+			sum[dir] += bfqg->lat_sum_us[dir];
+			max[dir] = max(max[dir], bfqg->lat_max_us[dir]);
+		}
+		wr_boosts += bfqg->wr_boosts;
+	}
+	rcu_read_unlock();
+	mutex_unlock(&bfqio_mutex);
+
+	for (dir = READ; dir <= WRITE; dir++) {
+		const char *name = dir == READ ? "read" : "write";
+
+		seq_printf(m, "%s_reqs %lu\n", name, nr[dir]);
+		seq_printf(m, "%s_avg_us %llu\n", name,
+			   nr[dir] ? div64_u64(sum[dir], nr[dir]) : 0);
+		seq_printf(m, "%s_max_us %llu\n", name, max[dir]);
+	}
+	seq_printf(m, "wr_boosts %lu\n", wr_boosts);
+
+	return 0;
+}
+
 static struct cftype bfqio_files[] = {
 	{
 		.name = "weight",
@@ -734,6 +827,10 @@ static struct cftype bfqio_files[] = {
 		.read_u64 = bfqio_cgroup_ioprio_class_read,
 		.write_u64 = bfqio_cgroup_ioprio_class_write,
 	},
+	{
+		.name = "latency",
+		.read_seq_string = bfqio_cgroup_latency_read,
+	},
 	{ },	/* terminate */
 };
 
@@ -861,6 +958,21 @@ static inline void bfq_init_entity(struct bfq_entity *entity,
 	entity->sched_data = &bfqg->sched_data;
 }
 
+static inline bool bfq_bfqq_in_fg_group(struct bfq_data *bfqd,
+					struct bfq_queue *bfqq)
+{
+	return false;
+}
+
+static inline void bfq_group_account_rq(struct bfq_queue *bfqq,
+					struct request *rq)
+{
+}
+
+static inline void bfq_group_account_wr_boost(struct bfq_queue *bfqq)
+{
+}
+
 static inline struct bfq_group *
 bfq_bic_update_cgroup(struct bfq_io_cq *bic)
 {
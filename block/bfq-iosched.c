@@ -842,8 +842,18 @@ static void bfq_add_request(struct request *rq)
 		soft_rt = bfqd->bfq_wr_max_softrt_rate > 0 &&
 			!bfq_bfqq_in_large_burst(bfqq) &&
 			time_is_before_jiffies(bfqq->soft_rt_next_start);
-		interactive = !bfq_bfqq_in_large_burst(bfqq) &&
-			      idle_for_long_time;
+		/*
+		 * Queues of foreground groups are treated as interactive
+		 * on every activation: app launches are both bursty and
+		 * preceded by recent I/O, which defeats the heuristics.
+		 */
+		if (bfq_bfqq_in_fg_group(bfqd, bfqq))
+			bfq_mark_bfqq_fg_boost(bfqq);
+		else
+			bfq_clear_bfqq_fg_boost(bfqq);
+		interactive = bfq_bfqq_fg_boost(bfqq) ||
+			      (!bfq_bfqq_in_large_burst(bfqq) &&
+			       idle_for_long_time);
 		entity->budget = max_t(unsigned long, bfqq->max_budget,
 				       bfq_serv_to_charge(next_rq, bfqq));
 
@@ -868,6 +878,8 @@ static void bfq_add_request(struct request *rq)
 		 */
 		if (old_wr_coeff == 1 && (interactive || soft_rt)) {
 			bfqq->wr_coeff = bfqd->bfq_wr_coeff;
+			if (bfq_bfqq_fg_boost(bfqq))
+				bfq_group_account_wr_boost(bfqq);
 			if (interactive)
 				bfqq->wr_cur_max_time = bfq_wr_duration(bfqd);
 			else
@@ -880,7 +892,8 @@ static void bfq_add_request(struct request *rq)
 		} else if (old_wr_coeff > 1) {
 			if (interactive)
 				bfqq->wr_cur_max_time = bfq_wr_duration(bfqd);
-			else if (bfq_bfqq_in_large_burst(bfqq) ||
+			else if ((bfq_bfqq_in_large_burst(bfqq) &&
+				  !bfq_bfqq_fg_boost(bfqq)) ||
 				 (bfqq->wr_cur_max_time ==
 				  bfqd->bfq_wr_rt_max_time &&
 				  !soft_rt)) {
@@ -2377,11 +2390,15 @@ static void bfq_update_wr_data(struct bfq_data *bfqd,
 		if (entity->ioprio_changed)
 			bfq_log_bfqq(bfqd, bfqq, "WARN: pending prio change");
 		/*
-		 * If the queue was activated in a burst, or
-		 * too much time has elapsed from the beginning
-		 * of this weight-raising, then end weight raising.
+		 * If the queue was activated in a burst (and does not
+		 * belong to a foreground group), or too much time has
+		 * elapsed from the beginning of this weight-raising,
+		 * then end weight raising. The latter also bounds how
+		 * long a foreground group can keep a queue raised
+		 * while continuously backlogged.
 		 */
-		if (bfq_bfqq_in_large_burst(bfqq) ||
+		if ((bfq_bfqq_in_large_burst(bfqq) &&
+		     !bfq_bfqq_fg_boost(bfqq)) ||
 		    time_is_before_jiffies(bfqq->last_wr_start_finish +
 					   bfqq->wr_cur_max_time)) {
 			bfqq->last_wr_start_finish = jiffies;
@@ -3099,6 +3116,7 @@ static void bfq_completed_request(struct request_queue *q, struct request *rq)
 		     blk_rq_sectors(rq), sync);
 
 	bfq_update_hw_tag(bfqd);
+	bfq_group_account_rq(bfqq, rq);
 
 	BUG_ON(!bfqd->rq_in_driver);
 	BUG_ON(!bfqq->dispatched);
@@ -3541,6 +3559,7 @@ static int bfq_init_queue(struct request_queue *q, struct elevator_type *e)
 	bfqd->bfq_wr_max_time = 0;
 	bfqd->bfq_wr_min_idle_time = msecs_to_jiffies(2000);
 	bfqd->bfq_wr_min_inter_arr_async = msecs_to_jiffies(500);
+	bfqd->bfq_wr_fg_weight = 0;
 	bfqd->bfq_wr_max_softrt_rate = 7000; /*
 					      * Approximate rate required
 					      * to playback or record a
@@ -3668,6 +3687,7 @@ SHOW_FUNCTION(bfq_wr_min_idle_time_show, bfqd->bfq_wr_min_idle_time, 1);
 SHOW_FUNCTION(bfq_wr_min_inter_arr_async_show, bfqd->bfq_wr_min_inter_arr_async,
 	1);
 SHOW_FUNCTION(bfq_wr_max_softrt_rate_show, bfqd->bfq_wr_max_softrt_rate, 0);
+SHOW_FUNCTION(bfq_wr_fg_weight_show, bfqd->bfq_wr_fg_weight, 0);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -3710,6 +3730,8 @@ STORE_FUNCTION(bfq_wr_min_inter_arr_async_store,
 		&bfqd->bfq_wr_min_inter_arr_async, 0, INT_MAX, 1);
 STORE_FUNCTION(bfq_wr_max_softrt_rate_store, &bfqd->bfq_wr_max_softrt_rate, 0,
 		INT_MAX, 0);
+STORE_FUNCTION(bfq_wr_fg_weight_store, &bfqd->bfq_wr_fg_weight, 0,
+		BFQ_MAX_WEIGHT, 0);
 #undef STORE_FUNCTION
 
 /* do nothing for the moment */
@@ -3805,6 +3827,7 @@ static struct elv_fs_entry bfq_attrs[] = {
 	BFQ_ATTR(wr_min_idle_time),
 	BFQ_ATTR(wr_min_inter_arr_async),
 	BFQ_ATTR(wr_max_softrt_rate),
+	BFQ_ATTR(wr_fg_weight),
 	BFQ_ATTR(weights),
 	__ATTR_NULL
 };
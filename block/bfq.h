@@ -439,6 +439,9 @@ enum bfq_device_speed {
  *				(in jiffies).
  * @bfq_wr_max_softrt_rate: max service-rate for a soft real-time queue,
  *			    sectors per seconds.
+ * @bfq_wr_fg_weight: minimum bfqio.weight of a group whose queues are
+ *		      weight-raised whenever they get backlogged, 0 to
+ *		      disable.
  * @RT_prod: cached value of the product R*T used for computing the maximum
  *	     duration of the weight raising automatically.
  * @device_speed: device-speed class for the low-latency heuristic.
@@ -522,6 +525,7 @@ struct bfq_data {
 	unsigned int bfq_wr_min_idle_time;
 	unsigned long bfq_wr_min_inter_arr_async;
 	unsigned int bfq_wr_max_softrt_rate;
+	unsigned int bfq_wr_fg_weight;
 	u64 RT_prod;
 	enum bfq_device_speed device_speed;
 
@@ -556,6 +560,10 @@ enum bfqq_state_flags {
 					 */
 	BFQ_BFQQ_FLAG_coop,		/* bfqq is shared */
 	BFQ_BFQQ_FLAG_split_coop,	/* shared bfqq will be splitted */
+	BFQ_BFQQ_FLAG_fg_boost,		/*
+					 * bfqq belongs to a foreground
+					 * group, see bfq_wr_fg_weight
+					 */
 };
 
 #define BFQ_BFQQ_FNS(name)						\
@@ -586,6 +594,7 @@ BFQ_BFQQ_FNS(constantly_seeky);
 BFQ_BFQQ_FNS(coop);
 BFQ_BFQQ_FNS(split_coop);
 BFQ_BFQQ_FNS(softrt_update);
+BFQ_BFQQ_FNS(fg_boost);
 #undef BFQ_BFQQ_FNS
 
 /* Logging facilities. */
@@ -629,6 +638,12 @@ enum bfqq_expiration {
  *                   are groups with more than one active @bfq_entity
  *                   (see the comments to the function
  *                   bfq_bfqq_must_not_expire()).
+ * @lat_nr: number of completed requests, per direction.
+ * @lat_sum_us: sum of the queue-to-completion latencies of the completed
+ *              requests (usecs), per direction.
+ * @lat_max_us: max queue-to-completion latency (usecs), per direction.
+ * @wr_boosts: number of weight-raising periods started because the group
+ *             is a foreground one.
  *
  * Each (device, cgroup) pair has its own bfq_group, i.e., for each cgroup
  * there is a set of bfq_groups, each one collecting the lower-level
@@ -656,6 +671,11 @@ struct bfq_group {
 	struct bfq_entity *my_entity;
 
 	int active_entities;
+
+	unsigned long lat_nr[2];
+	u64 lat_sum_us[2];
+	u64 lat_max_us[2];
+	unsigned long wr_boosts;
 };
 
 /**
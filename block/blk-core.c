@@ -308,16 +308,31 @@ inline void __blk_run_queue_uncond(struct request_queue *q)
 	 * number of active request_fn invocations such that blk_drain_queue()
 	 * can wait until all these request_fn calls have finished.
 	 */
+	/*
+	 * On a single dispatch queue, a caller that finds request_fn already
+	 * running on another CPU leaves the dispatch to it instead of
+	 * spinning on the queue lock inside a second request_fn. The active
+	 * caller notices request_fn_rerun once request_fn returns and runs
+	 * it again, so newly queued requests are never left behind.
+	 */
+	if (blk_queue_single_dispatch(q) && q->request_fn_active) {
+		q->request_fn_rerun = 1;
+		return;
+	}
+
 	q->request_fn_active++;
-	if (!q->notified_urgent &&
-		q->elevator->type->ops.elevator_is_urgent_fn &&
-		q->urgent_request_fn &&
-		q->elevator->type->ops.elevator_is_urgent_fn(q) &&
-		list_empty(&q->flush_data_in_flight)) {
-		q->notified_urgent = true;
-		q->urgent_request_fn(q);
-	} else
-		q->request_fn(q);
+	do {
+		q->request_fn_rerun = 0;
+		if (!q->notified_urgent &&
+			q->elevator->type->ops.elevator_is_urgent_fn &&
+			q->urgent_request_fn &&
+			q->elevator->type->ops.elevator_is_urgent_fn(q) &&
+			list_empty(&q->flush_data_in_flight)) {
+			q->notified_urgent = true;
+			q->urgent_request_fn(q);
+		} else
+			q->request_fn(q);
+	} while (unlikely(q->request_fn_rerun) && !blk_queue_dead(q));
 	q->request_fn_active--;
 }
 
@@ -2484,6 +2499,7 @@ static void blk_finish_request(struct request *req, int error)
 
 
 	blk_account_io_done(req);
+	blk_throtl_rq_done(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
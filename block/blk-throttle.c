@@ -21,6 +21,9 @@ static int throtl_quantum = 32;
 /* Throttling is performed over 100ms slice and after that slice is renewed */
 static unsigned long throtl_slice = HZ/10;	/* 100 ms */
 
+/* Lowest IOPS cap latency target mode puts on a background group */
+#define THROTL_LAT_MIN_IOPS	16
+
 static struct blkcg_policy blkcg_policy_throtl;
 
 /* A workqueue to queue throttle related work */
@@ -88,6 +91,16 @@ struct throtl_grp {
 	/* Some throttle limits got updated for the group */
 	int limits_changed;
 
+	/* Completion latency target in usecs, -1 if none */
+	uint64_t latency_target;
+	/* IOPS cap imposed by other groups' latency targets, -1 if none */
+	unsigned int lat_iops;
+	/* Completions and their total latency in the current window */
+	unsigned int lat_nr;
+	uint64_t lat_sum_us;
+	/* Windows where the target was missed */
+	unsigned long lat_missed;
+
 	/* Per cpu stats pointer */
 	struct tg_stats_cpu __percpu *stats_cpu;
 
@@ -114,6 +127,9 @@ struct throtl_data
 	struct delayed_work throtl_work;
 
 	int limits_changed;
+
+	/* Start of the current latency target window */
+	unsigned long lat_window_start;
 };
 
 /* list and work item to allocate percpu group stats */
@@ -229,6 +245,8 @@ static void throtl_pd_init(struct blkcg_gq *blkg)
 	tg->bps[WRITE] = -1;
 	tg->iops[READ] = -1;
 	tg->iops[WRITE] = -1;
+	tg->latency_target = -1;
+	tg->lat_iops = -1;
 
 	/*
 	 * Ugh... We need to perform per-cpu allocation for tg->stats_cpu
@@ -424,6 +442,12 @@ static void throtl_schedule_next_dispatch(struct throtl_data *td)
 		throtl_schedule_delayed_work(td, (st->min_disptime - jiffies));
 }
 
+/* Configured IOPS limit, lowered by the latency target cap if any */
+static inline unsigned int tg_iops(struct throtl_grp *tg, bool rw)
+{
+	return min(tg->iops[rw], tg->lat_iops);
+}
+
 static inline void
 throtl_start_new_slice(struct throtl_data *td, struct throtl_grp *tg, bool rw)
 {
@@ -498,7 +522,7 @@ throtl_trim_slice(struct throtl_data *td, struct throtl_grp *tg, bool rw)
 	do_div(tmp, HZ);
 	bytes_trim = tmp;
 
-	io_trim = (tg->iops[rw] * throtl_slice * nr_slices)/HZ;
+	io_trim = (tg_iops(tg, rw) * throtl_slice * nr_slices)/HZ;
 
 	if (!bytes_trim && !io_trim)
 		return;
@@ -544,7 +568,7 @@ static bool tg_with_in_iops_limit(struct throtl_data *td, struct throtl_grp *tg,
 	 * have been trimmed.
 	 */
 
-	tmp = (u64)tg->iops[rw] * jiffy_elapsed_rnd;
+	tmp = (u64)tg_iops(tg, rw) * jiffy_elapsed_rnd;
 	do_div(tmp, HZ);
 
 	if (tmp > UINT_MAX)
@@ -559,7 +583,7 @@ static bool tg_with_in_iops_limit(struct throtl_data *td, struct throtl_grp *tg,
 	}
 
 	/* Calc approx time to dispatch */
-	jiffy_wait = ((tg->io_disp[rw] + 1) * HZ)/tg->iops[rw] + 1;
+	jiffy_wait = ((tg->io_disp[rw] + 1) * HZ)/tg_iops(tg, rw) + 1;
 
 	if (jiffy_wait > jiffy_elapsed)
 		jiffy_wait = jiffy_wait - jiffy_elapsed;
@@ -614,7 +638,7 @@ static bool tg_with_in_bps_limit(struct throtl_data *td, struct throtl_grp *tg,
 }
 
 static bool tg_no_rule_group(struct throtl_grp *tg, bool rw) {
-	if (tg->bps[rw] == -1 && tg->iops[rw] == -1)
+	if (tg->bps[rw] == -1 && tg_iops(tg, rw) == -1)
 		return 1;
 	return 0;
 }
@@ -638,7 +662,7 @@ static bool tg_may_dispatch(struct throtl_data *td, struct throtl_grp *tg,
 	BUG_ON(tg->nr_queued[rw] && bio != bio_list_peek(&tg->bio_lists[rw]));
 
 	/* If tg->bps = -1, then BW is unlimited */
-	if (tg->bps[rw] == -1 && tg->iops[rw] == -1) {
+	if (tg->bps[rw] == -1 && tg_iops(tg, rw) == -1) {
 		if (wait)
 			*wait = 0;
 		return 1;
@@ -851,7 +875,7 @@ static void throtl_process_limit_change(struct throtl_data *td)
 
 		throtl_log_tg(td, tg, "limit change rbps=%llu wbps=%llu"
 			" riops=%u wiops=%u", tg->bps[READ], tg->bps[WRITE],
-			tg->iops[READ], tg->iops[WRITE]);
+			tg_iops(tg, READ), tg_iops(tg, WRITE));
 
 		/*
 		 * Restart the slices for both READ and WRITES. It
@@ -935,6 +959,106 @@ throtl_schedule_delayed_work(struct throtl_data *td, unsigned long delay)
 	}
 }
 
+/*
+ * Latency target mode. Every throtl_slice the average completion latency
+ * of each group with a latency target is compared with the target. When
+ * a group misses it, every active group without a target is capped to
+ * half the IOPS it just completed, but never below THROTL_LAT_MIN_IOPS.
+ * Each window where all targets are met doubles the caps. A cap is lifted
+ * once it no longer binds, or as soon as the groups with targets go idle,
+ * so background I/O runs at full speed on an otherwise idle device.
+ * The root group is never capped: it carries the I/O of every task not
+ * placed in a cgroup, including kernel threads doing swap and writeback.
+ * Called with queue lock held.
+ */
+static void throtl_lat_window_end(struct throtl_data *td)
+{
+	struct request_queue *q = td->queue;
+	unsigned long window = max(jiffies - td->lat_window_start, 1UL);
+	bool missed = false, fg_active = false, changed = false;
+	struct blkcg_gq *blkg;
+
+	td->lat_window_start = jiffies;
+
+	list_for_each_entry(blkg, &q->blkg_list, q_node) {
+		struct throtl_grp *tg = blkg_to_tg(blkg);
+
+		if (tg->latency_target == -1 || !tg->lat_nr)
+			continue;
+
+		fg_active = true;
+		if (div_u64(tg->lat_sum_us, tg->lat_nr) > tg->latency_target) {
+			tg->lat_missed++;
+			missed = true;
+		}
+	}
+
+	list_for_each_entry(blkg, &q->blkg_list, q_node) {
+		struct throtl_grp *tg = blkg_to_tg(blkg);
+		unsigned int rate = tg->lat_nr * HZ / window;
+		unsigned int iops = tg->lat_iops;
+
+		tg->lat_nr = 0;
+		tg->lat_sum_us = 0;
+
+		if (tg->latency_target != -1 || tg == td_root_tg(td))
+			continue;
+
+		if (!fg_active)
+			iops = -1;
+		else if (missed && rate)
+			iops = max_t(unsigned int, min(rate, iops) / 2,
+				     THROTL_LAT_MIN_IOPS);
+		else if (!missed && iops != -1)
+			iops = rate < iops / 2 || iops > UINT_MAX / 4 ?
+				-1 : iops * 2;
+
+		if (iops != tg->lat_iops) {
+			throtl_log_tg(td, tg, "latency cap iops=%u rate=%u",
+				      iops, rate);
+			tg->lat_iops = iops;
+			xchg(&tg->limits_changed, true);
+			changed = true;
+		}
+	}
+
+	if (changed) {
+		xchg(&td->limits_changed, true);
+		throtl_schedule_delayed_work(td, 0);
+	}
+}
+
+/**
+ * blk_throtl_rq_done - account a completed request for latency targets
+ * @rq: request being completed
+ *
+ * Called with queue lock held.
+ */
+void blk_throtl_rq_done(struct request *rq)
+{
+	struct throtl_data *td = rq->q->td;
+	struct request_list *rl = blk_rq_rl(rq);
+	struct throtl_grp *tg;
+	u64 now = sched_clock();
+
+	if (!td || !rl || !rl->blkg || rq->cmd_type != REQ_TYPE_FS ||
+	    (rq->cmd_flags & REQ_FLUSH_SEQ))
+		return;
+
+	tg = blkg_to_tg(rl->blkg);
+	if (!tg)
+		return;
+
+	if (now > rq_start_time_ns(rq)) {
+		tg->lat_nr++;
+		tg->lat_sum_us += div_u64(now - rq_start_time_ns(rq),
+					  NSEC_PER_USEC);
+	}
+
+	if (time_after_eq(jiffies, td->lat_window_start + throtl_slice))
+		throtl_lat_window_end(td);
+}
+
 static u64 tg_prfill_cpu_rwstat(struct seq_file *sf,
 				struct blkg_policy_data *pd, int off)
 {
@@ -988,6 +1112,22 @@ static u64 tg_prfill_conf_uint(struct seq_file *sf, struct blkg_policy_data *pd,
 	return __blkg_prfill_u64(sf, pd, v);
 }
 
+static u64 tg_prfill_ulong(struct seq_file *sf, struct blkg_policy_data *pd,
+			   int off)
+{
+	struct throtl_grp *tg = pd_to_tg(pd);
+
+	return __blkg_prfill_u64(sf, pd, *(unsigned long *)((void *)tg + off));
+}
+
+static int tg_print_ulong(struct cgroup *cgrp, struct cftype *cft,
+			  struct seq_file *sf)
+{
+	blkcg_print_blkgs(sf, cgroup_to_blkcg(cgrp), tg_prfill_ulong,
+			  &blkcg_policy_throtl, cft->private, false);
+	return 0;
+}
+
 static int tg_print_conf_u64(struct cgroup *cgrp, struct cftype *cft,
 			     struct seq_file *sf)
 {
@@ -1078,6 +1218,23 @@ static struct cftype throtl_files[] = {
 		.write_string = tg_set_conf_uint,
 		.max_write_len = 256,
 	},
+	{
+		.name = "throttle.latency_target_device",
+		.private = offsetof(struct throtl_grp, latency_target),
+		.read_seq_string = tg_print_conf_u64,
+		.write_string = tg_set_conf_u64,
+		.max_write_len = 256,
+	},
+	{
+		.name = "throttle.latency_missed",
+		.private = offsetof(struct throtl_grp, lat_missed),
+		.read_seq_string = tg_print_ulong,
+	},
+	{
+		.name = "throttle.latency_iops_cap",
+		.private = offsetof(struct throtl_grp, lat_iops),
+		.read_seq_string = tg_print_conf_uint,
+	},
 	{
 		.name = "throttle.io_service_bytes",
 		.private = offsetof(struct tg_stats_cpu, service_bytes),
@@ -1245,6 +1402,7 @@ int blk_throtl_init(struct request_queue *q)
 
 	td->tg_service_tree = THROTL_RB_ROOT;
 	td->limits_changed = false;
+	td->lat_window_start = jiffies;
 	INIT_DELAYED_WORK(&td->throtl_work, blk_throtl_work);
 
 	q->td = td;
@@ -99,6 +99,31 @@ static const struct row_queue_params row_queues_def[] = {
 #define ROW_IDLE_TIME_MSEC 10
 #define ROW_READ_FREQ_MSEC 25
 
+/*
+ * Latency based auto tuning.
+ *
+ * Request service time (dispatch to completion) is tracked as an EWMA per
+ * latency class. Every ROW_TUNE_INTERVAL completions the idle window is set
+ * to ROW_IDLE_LAT_MULT read service times, and the read arrival window that
+ * triggers idling to ROW_FREQ_IDLE_MULT idle windows, both capped by the
+ * rd_idle_data/rd_idle_data_freq values. Write quanta are scaled by how much
+ * cheaper (or dearer) a write is than ROW_REF_WRITE_COST reads, the ratio the
+ * default quanta were tuned for, so writes keep the same share of bus time.
+ */
+enum row_lat_class {
+	ROW_LAT_READ = 0,
+	ROW_LAT_SWRITE,
+	ROW_LAT_WRITE,
+	ROW_LAT_MAX,
+};
+
+#define ROW_EWMA_SHIFT		3	/* new sample weight 1/8 */
+#define ROW_TUNE_INTERVAL	32
+#define ROW_IDLE_LAT_MULT	4
+#define ROW_FREQ_IDLE_MULT	3
+#define ROW_IDLE_MIN_USEC	200
+#define ROW_REF_WRITE_COST	4
+
 /**
  * struct rowq_idling_data -  parameters for idling on the queue
  * @last_insert_time:	time the last request was inserted
@@ -121,6 +146,7 @@ struct rowq_idling_data {
  * @nr_req:		number of requests in queue
  * @dispatch quantum:	number of requests this queue may
  *			dispatch in a dispatch cycle
+ * @base_quantum:	configured quantum disp_quantum is tuned from
  * @idle_data:		data for idling on queues
  *
  */
@@ -133,6 +159,7 @@ struct row_queue {
 
 	unsigned int		nr_req;
 	int			disp_quantum;
+	int			base_quantum;
 
 	/* used only for READ queues */
 	struct rowq_idling_data	idle_data;
@@ -140,9 +167,12 @@ struct row_queue {
 
 /**
  * struct idling_data - data for idling on empty rqueue
- * @idle_time_ms:		idling duration (msec)
- * @freq_ms:		min time between two requests that
+ * @idle_time_ms:		max idling duration (msec)
+ * @freq_ms:		max time between two requests that
  *			triger idling (msec)
+ * @idle_time_us:	idling duration in use (usec)
+ * @freq_us:		time between two requests that triggers
+ *			idling in use (usec)
  * @hr_timer:	idling timer
  * @idle_work:	the work to be scheduled when idling timer expires
  * @idling_queue_idx:	index of the queues we're idling on
@@ -151,6 +181,8 @@ struct row_queue {
 struct idling_data {
 	s64				idle_time_ms;
 	s64				freq_ms;
+	s64				idle_time_us;
+	s64				freq_us;
 
 	struct hrtimer			hr_timer;
 	struct work_struct		idle_work;
@@ -171,6 +203,20 @@ struct starvation_data {
 	int				starvation_counter;
 };
 
+/**
+ * struct row_lat_data - measured service latency
+ * @auto_tune:		tune idling and write quanta from @ewma_us
+ * @ewma_us:		service time EWMA per enum row_lat_class, in usec
+ *			scaled by 1 << ROW_EWMA_SHIFT
+ * @nr_samples:		completions since the last tuning
+ *
+ */
+struct row_lat_data {
+	int				auto_tune;
+	unsigned long			ewma_us[ROW_LAT_MAX];
+	unsigned int			nr_samples;
+};
+
 /**
  * struct row_queue - Per block device rqueue structure
  * @dispatch_queue:	dispatch rqueue
@@ -187,6 +233,7 @@ struct starvation_data {
  * @reg_prio_starvation: starvation data for REGULAR priority queues
  * @low_prio_starvation: starvation data for LOW priority queues
  * @cycle_flags:	used for marking unserved queueus
+ * @lat_data:		measured latencies for auto tuning
  *
  */
 struct row_data {
@@ -206,9 +253,13 @@ struct row_data {
 	struct starvation_data		low_prio_starvation;
 
 	unsigned int			cycle_flags;
+
+	struct row_lat_data		lat_data;
 };
 
 #define RQ_ROWQ(rq) ((struct row_queue *) ((rq)->elv.priv[0]))
+/* usec timestamp of the dispatch to the driver, truncated to a long */
+#define RQ_DISP_US(rq) ((unsigned long) ((rq)->elv.priv[1]))
 
 #define row_log(q, fmt, args...)   \
 	blk_add_trace_msg(q, "%s():" fmt , __func__, ##args)
@@ -329,7 +380,7 @@ static void row_add_request(struct request_queue *q,
 {
 	struct row_data *rd = (struct row_data *)q->elevator->elevator_data;
 	struct row_queue *rqueue = RQ_ROWQ(rq);
-	s64 diff_ms;
+	s64 diff_us;
 	bool queue_was_empty = list_empty(&rqueue->fifo);
 
 	list_add_tail(&rq->queuelist, &rqueue->fifo);
@@ -355,21 +406,21 @@ static void row_add_request(struct request_queue *q,
 					ROWQ_MAX_PRIO;
 			}
 		}
-		diff_ms = ktime_to_ms(ktime_sub(ktime_get(),
+		diff_us = ktime_to_us(ktime_sub(ktime_get(),
 				rqueue->idle_data.last_insert_time));
-		if (unlikely(diff_ms < 0)) {
-			pr_err("%s(): time delta error: diff_ms < 0",
+		if (unlikely(diff_us < 0)) {
+			pr_err("%s(): time delta error: diff_us < 0",
 				__func__);
 			rqueue->idle_data.begin_idling = false;
 			return;
 		}
-		if (diff_ms < rd->rd_idle_data.freq_ms) {
+		if (diff_us < rd->rd_idle_data.freq_us) {
 			rqueue->idle_data.begin_idling = true;
 			row_log_rowq(rd, rqueue->prio, "Enable idling");
 		} else {
 			rqueue->idle_data.begin_idling = false;
-			row_log_rowq(rd, rqueue->prio, "Disable idling (%ldms)",
-				(long)diff_ms);
+			row_log_rowq(rd, rqueue->prio, "Disable idling (%ldus)",
+				(long)diff_us);
 		}
 
 		rqueue->idle_data.last_insert_time = ktime_get();
@@ -449,10 +500,121 @@ static int row_reinsert_req(struct request_queue *q,
 	return 0;
 }
 
+/*
+ * row_tune() - Derive idling and write quanta from the measured latencies
+ * @rd:		pointer to struct row_data
+ *
+ */
+static void row_tune(struct row_data *rd)
+{
+	struct row_lat_data *lat = &rd->lat_data;
+	s64 idle_max_us = rd->rd_idle_data.idle_time_ms * USEC_PER_MSEC;
+	s64 freq_max_us = rd->rd_idle_data.freq_ms * USEC_PER_MSEC;
+	unsigned long rd_us = lat->ewma_us[ROW_LAT_READ] >> ROW_EWMA_SHIFT;
+	unsigned long wr_us;
+	int i, q;
+
+	if (!lat->auto_tune || !rd_us)
+		return;
+
+	rd->rd_idle_data.idle_time_us = clamp_t(s64,
+		(s64)rd_us * ROW_IDLE_LAT_MULT,
+		min_t(s64, ROW_IDLE_MIN_USEC, idle_max_us), idle_max_us);
+	rd->rd_idle_data.freq_us = min_t(s64,
+		rd->rd_idle_data.idle_time_us * ROW_FREQ_IDLE_MULT,
+		freq_max_us);
+
+	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
+		struct row_queue *rqueue = &rd->row_queues[i];
+
+		switch (i) {
+		case ROWQ_PRIO_HIGH_SWRITE:
+		case ROWQ_PRIO_REG_SWRITE:
+		case ROWQ_PRIO_LOW_SWRITE:
+			wr_us = lat->ewma_us[ROW_LAT_SWRITE];
+			break;
+		case ROWQ_PRIO_REG_WRITE:
+			wr_us = lat->ewma_us[ROW_LAT_WRITE];
+			break;
+		default:
+			continue;
+		}
+		wr_us >>= ROW_EWMA_SHIFT;
+		if (!wr_us)
+			continue;
+
+		q = div_u64((u64)rqueue->base_quantum * ROW_REF_WRITE_COST *
+			rd_us, wr_us);
+		rqueue->disp_quantum = clamp_t(int, q, 1,
+			rqueue->base_quantum * ROW_REF_WRITE_COST);
+	}
+
+	row_log(rd->dispatch_queue, "tuned: idle=%lldus freq=%lldus rd=%luus",
+		rd->rd_idle_data.idle_time_us, rd->rd_idle_data.freq_us, rd_us);
+}
+
+/*
+ * row_reset_tuning() - Go back to the configured idling and quanta
+ * @rd:		pointer to struct row_data
+ *
+ */
+static void row_reset_tuning(struct row_data *rd)
+{
+	int i;
+
+	rd->rd_idle_data.idle_time_us =
+		rd->rd_idle_data.idle_time_ms * USEC_PER_MSEC;
+	rd->rd_idle_data.freq_us = rd->rd_idle_data.freq_ms * USEC_PER_MSEC;
+	for (i = 0; i < ROWQ_MAX_PRIO; i++)
+		rd->row_queues[i].disp_quantum = rd->row_queues[i].base_quantum;
+}
+
+static void row_activate_req(struct request_queue *q, struct request *rq)
+{
+	rq->elv.priv[1] = (void *)(unsigned long)ktime_to_us(ktime_get());
+}
+
+/*
+ * row_update_latency() - Account the service time of a completed request
+ * @rd:		pointer to struct row_data
+ * @rq:		completed request
+ *
+ */
+static void row_update_latency(struct row_data *rd, struct request *rq)
+{
+	struct row_lat_data *lat = &rd->lat_data;
+	unsigned long now = (unsigned long)ktime_to_us(ktime_get());
+	unsigned long *ewma;
+
+	if (!RQ_DISP_US(rq))
+		return;
+
+	if (rq_data_dir(rq) == READ)
+		ewma = &lat->ewma_us[ROW_LAT_READ];
+	else if (rq_is_sync(rq))
+		ewma = &lat->ewma_us[ROW_LAT_SWRITE];
+	else
+		ewma = &lat->ewma_us[ROW_LAT_WRITE];
+
+	/* ewma is kept scaled by 1 << ROW_EWMA_SHIFT */
+	if (!*ewma)
+		*ewma = (now - RQ_DISP_US(rq)) << ROW_EWMA_SHIFT;
+	else
+		*ewma += (now - RQ_DISP_US(rq)) -
+			(*ewma >> ROW_EWMA_SHIFT);
+
+	if (++lat->nr_samples >= ROW_TUNE_INTERVAL) {
+		lat->nr_samples = 0;
+		row_tune(rd);
+	}
+}
+
 static void row_completed_req(struct request_queue *q, struct request *rq)
 {
 	struct row_data *rd = q->elevator->elevator_data;
 
+	row_update_latency(rd, rq);
+
 	 if (rq->cmd_flags & REQ_URGENT) {
 		if (!rd->urgent_in_flight) {
 			WARN_ON(1);
@@ -644,7 +806,7 @@ check_idling:
 
 initiate_idling:
 	hrtimer_start(&rd->rd_idle_data.hr_timer,
-		ktime_set(0, rd->rd_idle_data.idle_time_ms * NSEC_PER_MSEC),
+		ns_to_ktime(rd->rd_idle_data.idle_time_us * NSEC_PER_USEC),
 		HRTIMER_MODE_REL);
 
 	rd->rd_idle_data.idling_queue_idx = i;
@@ -805,6 +967,7 @@ static int row_init_queue(struct request_queue *q, struct elevator_type *e)
 	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
 		INIT_LIST_HEAD(&rdata->row_queues[i].fifo);
 		rdata->row_queues[i].disp_quantum = row_queues_def[i].quantum;
+		rdata->row_queues[i].base_quantum = row_queues_def[i].quantum;
 		rdata->row_queues[i].rdata = rdata;
 		rdata->row_queues[i].prio = i;
 		rdata->row_queues[i].idle_data.begin_idling = false;
@@ -823,6 +986,8 @@ static int row_init_queue(struct request_queue *q, struct elevator_type *e)
 	 */
 	rdata->rd_idle_data.idle_time_ms = ROW_IDLE_TIME_MSEC;
 	rdata->rd_idle_data.freq_ms = ROW_READ_FREQ_MSEC;
+	row_reset_tuning(rdata);
+	rdata->lat_data.auto_tune = 1;
 	hrtimer_init(&rdata->rd_idle_data.hr_timer,
 		CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	rdata->rd_idle_data.hr_timer.function = &row_idle_hrtimer_fn;
@@ -951,6 +1116,7 @@ row_set_request(struct request_queue *q, struct request *rq, struct bio *bio,
 	spin_lock_irqsave(q->queue_lock, flags);
 	rq->elv.priv[0] =
 		(void *)(&rd->row_queues[row_get_queue_prio(rq, rd)]);
+	rq->elv.priv[1] = NULL;
 	spin_unlock_irqrestore(q->queue_lock, flags);
 
 	return 0;
@@ -997,6 +1163,15 @@ SHOW_FUNCTION(row_reg_starv_limit_show,
 	rowd->reg_prio_starvation.starvation_limit);
 SHOW_FUNCTION(row_low_starv_limit_show,
 	rowd->low_prio_starvation.starvation_limit);
+SHOW_FUNCTION(row_auto_tune_show, rowd->lat_data.auto_tune);
+SHOW_FUNCTION(row_rd_idle_us_show, rowd->rd_idle_data.idle_time_us);
+SHOW_FUNCTION(row_rd_idle_freq_us_show, rowd->rd_idle_data.freq_us);
+SHOW_FUNCTION(row_rd_lat_us_show,
+	rowd->lat_data.ewma_us[ROW_LAT_READ] >> ROW_EWMA_SHIFT);
+SHOW_FUNCTION(row_swrite_lat_us_show,
+	rowd->lat_data.ewma_us[ROW_LAT_SWRITE] >> ROW_EWMA_SHIFT);
+SHOW_FUNCTION(row_write_lat_us_show,
+	rowd->lat_data.ewma_us[ROW_LAT_WRITE] >> ROW_EWMA_SHIFT);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)			\
@@ -1011,27 +1186,29 @@ static ssize_t __FUNC(struct elevator_queue *e,				\
 	else if (__data > (MAX))					\
 		__data = (MAX);						\
 	*(__PTR) = __data;						\
+	row_reset_tuning(rowd);						\
+	row_tune(rowd);							\
 	return ret;							\
 }
 STORE_FUNCTION(row_hp_read_quantum_store,
-&rowd->row_queues[ROWQ_PRIO_HIGH_READ].disp_quantum, 1, INT_MAX);
+&rowd->row_queues[ROWQ_PRIO_HIGH_READ].base_quantum, 1, INT_MAX);
 STORE_FUNCTION(row_rp_read_quantum_store,
-			&rowd->row_queues[ROWQ_PRIO_REG_READ].disp_quantum,
+			&rowd->row_queues[ROWQ_PRIO_REG_READ].base_quantum,
 			1, INT_MAX);
 STORE_FUNCTION(row_hp_swrite_quantum_store,
-			&rowd->row_queues[ROWQ_PRIO_HIGH_SWRITE].disp_quantum,
+			&rowd->row_queues[ROWQ_PRIO_HIGH_SWRITE].base_quantum,
 			1, INT_MAX);
 STORE_FUNCTION(row_rp_swrite_quantum_store,
-			&rowd->row_queues[ROWQ_PRIO_REG_SWRITE].disp_quantum,
+			&rowd->row_queues[ROWQ_PRIO_REG_SWRITE].base_quantum,
 			1, INT_MAX);
 STORE_FUNCTION(row_rp_write_quantum_store,
-			&rowd->row_queues[ROWQ_PRIO_REG_WRITE].disp_quantum,
+			&rowd->row_queues[ROWQ_PRIO_REG_WRITE].base_quantum,
 			1, INT_MAX);
 STORE_FUNCTION(row_lp_read_quantum_store,
-			&rowd->row_queues[ROWQ_PRIO_LOW_READ].disp_quantum,
+			&rowd->row_queues[ROWQ_PRIO_LOW_READ].base_quantum,
 			1, INT_MAX);
 STORE_FUNCTION(row_lp_swrite_quantum_store,
-			&rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].disp_quantum,
+			&rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].base_quantum,
 			1, INT_MAX);
 STORE_FUNCTION(row_rd_idle_data_store, &rowd->rd_idle_data.idle_time_ms,
 			1, INT_MAX);
@@ -1043,12 +1220,15 @@ STORE_FUNCTION(row_reg_starv_limit_store,
 STORE_FUNCTION(row_low_starv_limit_store,
 			&rowd->low_prio_starvation.starvation_limit,
 			1, INT_MAX);
+STORE_FUNCTION(row_auto_tune_store, &rowd->lat_data.auto_tune, 0, 1);
 
 #undef STORE_FUNCTION
 
 #define ROW_ATTR(name) \
 	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
 				      row_##name##_store)
+#define ROW_ATTR_RO(name) \
+	__ATTR(name, S_IRUGO, row_##name##_show, NULL)
 
 static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(hp_read_quantum),
@@ -1062,6 +1242,12 @@ static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(rd_idle_data_freq),
 	ROW_ATTR(reg_starv_limit),
 	ROW_ATTR(low_starv_limit),
+	ROW_ATTR(auto_tune),
+	ROW_ATTR_RO(rd_idle_us),
+	ROW_ATTR_RO(rd_idle_freq_us),
+	ROW_ATTR_RO(rd_lat_us),
+	ROW_ATTR_RO(swrite_lat_us),
+	ROW_ATTR_RO(write_lat_us),
 	__ATTR_NULL
 };
 
@@ -1073,6 +1259,7 @@ static struct elevator_type iosched_row = {
 		.elevator_reinsert_req_fn	= row_reinsert_req,
 		.elevator_is_urgent_fn		= row_urgent_pending,
 		.elevator_completed_req_fn	= row_completed_req,
+		.elevator_activate_req_fn	= row_activate_req,
 		.elevator_former_req_fn		= elv_rb_former_request,
 		.elevator_latter_req_fn		= elv_rb_latter_request,
 		.elevator_set_req_fn		= row_set_request,
@@ -15,6 +15,11 @@
  *
  * The plus version incorporates several fixes and logic improvements.
  *
+ * Requests are also kept in a per direction rbtree sorted by sector. Once a
+ * request is picked from the fifos, up to fifo_batch requests following it
+ * in sector order are dispatched behind it, so streams of writes reach the
+ * device sequentially, unless a sync read expires in the meantime.
+ *
  */
 #include <linux/blkdev.h>
 #include <linux/elevator.h>
@@ -23,6 +28,7 @@
 #include <linux/init.h>
 #include <linux/version.h>
 #include <linux/slab.h>
+#include <linux/rbtree.h>
 
 enum { ASYNC, SYNC };
 
@@ -34,13 +40,19 @@ static const int async_read_expire = (HZ / 2);	/* ditto for async, these limits
 static const int async_write_expire = (HZ * 2);	/* ditto for async, these limits are SOFT! */
 
 static const int writes_starved = 1;		/* max times reads can starve a write */
-static const int fifo_batch     = 3;		/* # of sequential requests treated as one
+static const int fifo_batch     = 8;		/* # of sequential requests treated as one
 						   by the above parameters. For throughput. */
 
 /* Elevator data */
 struct sio_data {
 	/* Request queues */
 	struct list_head fifo_list[2][2];
+	struct rb_root sort_list[2];
+
+	/* Next request in sector order for the current batch, or NULL */
+	struct request *next_rq[2];
+	/* End sector of the last dispatched request */
+	sector_t batch_end;
 
 	/* Attributes */
 	unsigned int batched;
@@ -52,10 +64,68 @@ struct sio_data {
 	int writes_starved;
 };
 
+static inline struct rb_root *
+sio_rb_root(struct sio_data *sd, struct request *rq)
+{
+	return &sd->sort_list[rq_data_dir(rq)];
+}
+
+static void
+sio_del_rq_rb(struct sio_data *sd, struct request *rq)
+{
+	const int data_dir = rq_data_dir(rq);
+
+	if (sd->next_rq[data_dir] == rq) {
+		struct rb_node *node = rb_next(&rq->rb_node);
+
+		sd->next_rq[data_dir] = node ? rb_entry_rq(node) : NULL;
+	}
+
+	elv_rb_del(sio_rb_root(sd, rq), rq);
+}
+
+static void
+sio_remove_request(struct sio_data *sd, struct request *rq)
+{
+	rq_fifo_clear(rq);
+	sio_del_rq_rb(sd, rq);
+}
+
+static int
+sio_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+	sector_t sector = bio_end_sector(bio);
+	struct request *__rq;
+
+	/* Check for front merge, back merges are found by the elevator core */
+	__rq = elv_rb_find(&sd->sort_list[bio_data_dir(bio)], sector);
+	if (__rq && elv_rq_merge_ok(__rq, bio)) {
+		*req = __rq;
+		return ELEVATOR_FRONT_MERGE;
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void
+sio_merged_request(struct request_queue *q, struct request *rq, int type)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+
+	/* A front merge moved the start sector, reposition the request */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(sio_rb_root(sd, rq), rq);
+		elv_rb_add(sio_rb_root(sd, rq), rq);
+	}
+}
+
 static void
 sio_merged_requests(struct request_queue *q, struct request *rq,
 		    struct request *next)
 {
+	struct sio_data *sd = q->elevator->elevator_data;
+
 	/*
 	 * If next expires before rq, assign its expire time to rq
 	 * and move into next position (next will be deleted) in fifo.
@@ -68,7 +138,7 @@ sio_merged_requests(struct request_queue *q, struct request *rq,
 	}
 
 	/* Delete next request */
-	rq_fifo_clear(next);
+	sio_remove_request(sd, next);
 }
 
 static void
@@ -84,6 +154,7 @@ sio_add_request(struct request_queue *q, struct request *rq)
 	 */
 	rq_set_fifo_time(rq, jiffies + sd->fifo_expire[sync][data_dir]);
 	list_add_tail(&rq->queuelist, &sd->fifo_list[sync][data_dir]);
+	elv_rb_add(sio_rb_root(sd, rq), rq);
 }
 
 #if LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,38)
@@ -175,15 +246,44 @@ sio_choose_request(struct sio_data *sd, int data_dir)
 	return NULL;
 }
 
+static struct request *
+sio_batch_request(struct sio_data *sd)
+{
+	struct request *rq = sd->next_rq[READ] ? sd->next_rq[READ] :
+						 sd->next_rq[WRITE];
+
+	if (!rq || sd->batched >= sd->fifo_batch)
+		return NULL;
+
+	/* A batch only covers physically contiguous requests */
+	if (blk_rq_pos(rq) != sd->batch_end)
+		return NULL;
+
+	/* Do not hold back sync reads behind a write batch */
+	if (rq_data_dir(rq) == WRITE && !list_empty(&sd->fifo_list[SYNC][READ]))
+		return NULL;
+
+	sd->batched++;
+	return rq;
+}
+
 static inline void
 sio_dispatch_request(struct sio_data *sd, struct request *rq)
 {
+	const int data_dir = rq_data_dir(rq);
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	/* The batch continues with the next request in sector order */
+	sd->next_rq[READ] = NULL;
+	sd->next_rq[WRITE] = NULL;
+	sd->next_rq[data_dir] = node ? rb_entry_rq(node) : NULL;
+	sd->batch_end = blk_rq_pos(rq) + blk_rq_sectors(rq);
 
 	/*
-	 * Remove the request from the fifo list
-	 * and dispatch it.
+	 * Remove the request from the fifo list and
+	 * the sort tree and dispatch it.
 	 */
-	rq_fifo_clear(rq);
+	sio_remove_request(sd, rq);
 	elv_dispatch_add_tail(rq->q, rq);
 
 	if (rq_data_dir(rq)) {
@@ -202,11 +302,14 @@ sio_dispatch_requests(struct request_queue *q, int force)
 	struct request *rq = NULL;
 	int data_dir = READ;
 
+	/* Continue the current batch in sector order */
+	rq = sio_batch_request(sd);
+
 	/*
 	 * Retrieve any expired request after a batch of
 	 * sequential requests.
 	 */
-	if (sd->batched >= sd->fifo_batch)
+	if (!rq && sd->batched >= sd->fifo_batch)
 		rq = sio_choose_expired_request(sd);
 
 	/* Retrieve request */
@@ -225,34 +328,6 @@ sio_dispatch_requests(struct request_queue *q, int force)
 	return 1;
 }
 
-static struct request *
-sio_former_request(struct request_queue *q, struct request *rq)
-{
-	struct sio_data *sd = q->elevator->elevator_data;
-	const int sync = rq_is_sync(rq);
-	const int data_dir = rq_data_dir(rq);
-
-	if (rq->queuelist.prev == &sd->fifo_list[sync][data_dir])
-		return NULL;
-
-	/* Return former request */
-	return list_entry(rq->queuelist.prev, struct request, queuelist);
-}
-
-static struct request *
-sio_latter_request(struct request_queue *q, struct request *rq)
-{
-	struct sio_data *sd = q->elevator->elevator_data;
-	const int sync = rq_is_sync(rq);
-	const int data_dir = rq_data_dir(rq);
-
-	if (rq->queuelist.next == &sd->fifo_list[sync][data_dir])
-		return NULL;
-
-	/* Return latter request */
-	return list_entry(rq->queuelist.next, struct request, queuelist);
-}
-
 static int sio_init_queue(struct request_queue *q, struct elevator_type *e)
 {
 	struct sio_data *sd;
@@ -279,14 +354,20 @@ static int sio_init_queue(struct request_queue *q, struct elevator_type *e)
 	INIT_LIST_HEAD(&sd->fifo_list[SYNC][WRITE]);
 	INIT_LIST_HEAD(&sd->fifo_list[ASYNC][READ]);
 	INIT_LIST_HEAD(&sd->fifo_list[ASYNC][WRITE]);
+	sd->sort_list[READ] = RB_ROOT;
+	sd->sort_list[WRITE] = RB_ROOT;
+	sd->next_rq[READ] = NULL;
+	sd->next_rq[WRITE] = NULL;
 
 	/* Initialize data */
 	sd->batched = 0;
+	sd->starved = 0;
 	sd->fifo_expire[SYNC][READ] = sync_read_expire;
 	sd->fifo_expire[SYNC][WRITE] = sync_write_expire;
 	sd->fifo_expire[ASYNC][READ] = async_read_expire;
 	sd->fifo_expire[ASYNC][WRITE] = async_write_expire;
 	sd->fifo_batch = fifo_batch;
+	sd->writes_starved = writes_starved;
 
 	return 0;
 }
@@ -300,6 +381,8 @@ sio_exit_queue(struct elevator_queue *e)
 	BUG_ON(!list_empty(&sd->fifo_list[SYNC][WRITE]));
 	BUG_ON(!list_empty(&sd->fifo_list[ASYNC][READ]));
 	BUG_ON(!list_empty(&sd->fifo_list[ASYNC][WRITE]));
+	BUG_ON(!RB_EMPTY_ROOT(&sd->sort_list[READ]));
+	BUG_ON(!RB_EMPTY_ROOT(&sd->sort_list[WRITE]));
 
 	/* Free structure */
 	kfree(sd);
@@ -381,14 +464,16 @@ static struct elv_fs_entry sio_attrs[] = {
 
 static struct elevator_type iosched_sioplus = {
 	.ops = {
+		.elevator_merge_fn		= sio_merge,
+		.elevator_merged_fn		= sio_merged_request,
 		.elevator_merge_req_fn		= sio_merged_requests,
 		.elevator_dispatch_fn		= sio_dispatch_requests,
 		.elevator_add_req_fn		= sio_add_request,
 #if LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,38)
 		.elevator_queue_empty_fn	= sio_queue_empty,
 #endif
-		.elevator_former_req_fn		= sio_former_request,
-		.elevator_latter_req_fn		= sio_latter_request,
+		.elevator_former_req_fn		= elv_rb_former_request,
+		.elevator_latter_req_fn		= elv_rb_latter_request,
 		.elevator_init_fn		= sio_init_queue,
 		.elevator_exit_fn		= sio_exit_queue,
 	},
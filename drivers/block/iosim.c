@@ -0,0 +1,275 @@
+/*
+ * Simulated request-based block device for I/O scheduler evaluation.
+ *
+ * iosim exposes /dev/iosim0, a request-based disk that goes through the
+ * regular elevator path but keeps no data: reads return zeroes and writes
+ * are discarded. Each request is completed from an hrtimer after a service
+ * time taken from a simple device model:
+ *
+ *	service = <dir>_lat_us + bytes / <dir>_mbps + (seek_us if not sequential)
+ *
+ * served by "channels" independent units (1 models an eMMC that works on one
+ * command at a time, larger values model UFS style command queueing), with
+ * at most "queue_depth" requests in flight. All model parameters can be
+ * changed at runtime through /sys/module/iosim/parameters, which lets
+ * tools/iosched-bench compare elevators against different device classes.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/highmem.h>
+#include <linux/hrtimer.h>
+#include <linux/slab.h>
+#include <linux/fs.h>
+
+#define IOSIM_MAX_CHANNELS	32
+
+static int iosim_size_mb = 1024;
+module_param_named(size_mb, iosim_size_mb, int, S_IRUGO);
+MODULE_PARM_DESC(size_mb, "Capacity of the simulated disk in MB");
+
+static unsigned int iosim_queue_depth = 32;
+module_param_named(queue_depth, iosim_queue_depth, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(queue_depth, "Max requests in flight");
+
+static unsigned int iosim_channels = 1;
+module_param_named(channels, iosim_channels, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(channels, "Requests serviced concurrently (1 = eMMC like)");
+
+static unsigned int iosim_read_lat_us = 100;
+module_param_named(read_lat_us, iosim_read_lat_us, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int iosim_write_lat_us = 200;
+module_param_named(write_lat_us, iosim_write_lat_us, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int iosim_read_mbps = 250;
+module_param_named(read_mbps, iosim_read_mbps, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int iosim_write_mbps = 90;
+module_param_named(write_mbps, iosim_write_mbps, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int iosim_seek_us = 50;
+module_param_named(seek_us, iosim_seek_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(seek_us, "Extra service time of a non sequential request");
+
+struct iosim_cmd {
+	struct list_head list;
+	struct request *rq;
+	ktime_t done;
+};
+
+struct iosim_device {
+	spinlock_t lock;
+	struct request_queue *queue;
+	struct gendisk *disk;
+	int major;
+
+	struct hrtimer timer;
+	struct list_head in_flight;	/* sorted by completion time */
+	unsigned int nr_in_flight;
+
+	ktime_t busy_until[IOSIM_MAX_CHANNELS];
+	sector_t next_sector;
+};
+
+static struct iosim_device iosim_dev;
+static struct kmem_cache *iosim_cmd_cache;
+
+static u64 iosim_service_ns(struct iosim_device *dev, struct request *rq)
+{
+	int write = rq_data_dir(rq) == WRITE;
+	u64 mbps = write ? iosim_write_mbps : iosim_read_mbps;
+	u64 ns;
+
+	ns = (u64)(write ? iosim_write_lat_us : iosim_read_lat_us) * NSEC_PER_USEC;
+	if (mbps)
+		ns += div64_u64((u64)blk_rq_bytes(rq) * NSEC_PER_USEC, mbps);
+	if (blk_rq_pos(rq) != dev->next_sector)
+		ns += (u64)iosim_seek_us * NSEC_PER_USEC;
+	dev->next_sector = blk_rq_pos(rq) + blk_rq_sectors(rq);
+
+	return ns;
+}
+
+static void iosim_zero_request(struct request *rq)
+{
+	struct req_iterator iter;
+	struct bio_vec *bvec;
+	void *kaddr;
+
+	rq_for_each_segment(bvec, rq, iter) {
+		kaddr = kmap_atomic(bvec->bv_page);
+		memset(kaddr + bvec->bv_offset, 0, bvec->bv_len);
+		kunmap_atomic(kaddr);
+	}
+}
+
+/* called with dev->lock held */
+static void iosim_queue_cmd(struct iosim_device *dev, struct iosim_cmd *cmd)
+{
+	unsigned int channels = clamp_t(unsigned int, iosim_channels, 1,
+					IOSIM_MAX_CHANNELS);
+	ktime_t now = ktime_get(), start;
+	struct iosim_cmd *pos;
+	unsigned int i, ch = 0;
+
+	/* the channel that becomes free first serves the request */
+	for (i = 1; i < channels; i++)
+		if (ktime_compare(dev->busy_until[i], dev->busy_until[ch]) < 0)
+			ch = i;
+
+	start = ktime_compare(dev->busy_until[ch], now) > 0 ?
+		dev->busy_until[ch] : now;
+	cmd->done = ktime_add_ns(start, iosim_service_ns(dev, cmd->rq));
+	dev->busy_until[ch] = cmd->done;
+
+	list_for_each_entry_reverse(pos, &dev->in_flight, list)
+		if (ktime_compare(pos->done, cmd->done) <= 0)
+			break;
+	list_add(&cmd->list, &pos->list);
+	dev->nr_in_flight++;
+
+	if (dev->in_flight.next == &cmd->list)
+		hrtimer_start(&dev->timer, cmd->done, HRTIMER_MODE_ABS);
+}
+
+static void iosim_request_fn(struct request_queue *q)
+{
+	struct iosim_device *dev = q->queuedata;
+	struct iosim_cmd *cmd;
+	struct request *rq;
+
+	while (dev->nr_in_flight < max(iosim_queue_depth, 1U)) {
+		rq = blk_fetch_request(q);
+		if (!rq)
+			break;
+
+		if (rq->cmd_type != REQ_TYPE_FS) {
+			__blk_end_request_all(rq, -EIO);
+			continue;
+		}
+
+		cmd = kmem_cache_alloc(iosim_cmd_cache, GFP_ATOMIC);
+		if (!cmd) {
+			blk_requeue_request(q, rq);
+			break;
+		}
+		cmd->rq = rq;
+
+		if (rq_data_dir(rq) == READ)
+			iosim_zero_request(rq);
+
+		iosim_queue_cmd(dev, cmd);
+	}
+}
+
+static enum hrtimer_restart iosim_timer_fn(struct hrtimer *timer)
+{
+	struct iosim_device *dev = container_of(timer, struct iosim_device, timer);
+	struct iosim_cmd *cmd, *tmp;
+	unsigned long flags;
+	ktime_t now;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	now = ktime_get();
+	list_for_each_entry_safe(cmd, tmp, &dev->in_flight, list) {
+		if (ktime_compare(cmd->done, now) > 0)
+			break;
+		list_del(&cmd->list);
+		dev->nr_in_flight--;
+		__blk_end_request_all(cmd->rq, 0);
+		kmem_cache_free(iosim_cmd_cache, cmd);
+	}
+
+	/* room was made, feed the device again */
+	blk_run_queue_async(dev->queue);
+
+	/*
+	 * Re-arm with hrtimer_start() under the lock rather than returning
+	 * HRTIMER_RESTART, as iosim_queue_cmd() may start the timer too.
+	 */
+	if (!list_empty(&dev->in_flight)) {
+		cmd = list_first_entry(&dev->in_flight, struct iosim_cmd, list);
+		hrtimer_start(timer, cmd->done, HRTIMER_MODE_ABS);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+static const struct block_device_operations iosim_fops = {
+	.owner = THIS_MODULE,
+};
+
+static int __init iosim_init(void)
+{
+	struct iosim_device *dev = &iosim_dev;
+	int ret = -ENOMEM;
+
+	iosim_cmd_cache = KMEM_CACHE(iosim_cmd, 0);
+	if (!iosim_cmd_cache)
+		return -ENOMEM;
+
+	spin_lock_init(&dev->lock);
+	INIT_LIST_HEAD(&dev->in_flight);
+	hrtimer_init(&dev->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	dev->timer.function = iosim_timer_fn;
+
+	dev->major = register_blkdev(0, "iosim");
+	if (dev->major < 0) {
+		ret = dev->major;
+		goto out_cache;
+	}
+
+	dev->queue = blk_init_queue(iosim_request_fn, &dev->lock);
+	if (!dev->queue)
+		goto out_unregister;
+	dev->queue->queuedata = dev;
+	blk_queue_logical_block_size(dev->queue, 512);
+	blk_queue_max_hw_sectors(dev->queue, 1024);
+	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, dev->queue);
+	queue_flag_clear_unlocked(QUEUE_FLAG_ADD_RANDOM, dev->queue);
+
+	dev->disk = alloc_disk(1);
+	if (!dev->disk)
+		goto out_queue;
+	dev->disk->major = dev->major;
+	dev->disk->first_minor = 0;
+	dev->disk->fops = &iosim_fops;
+	dev->disk->private_data = dev;
+	dev->disk->queue = dev->queue;
+	sprintf(dev->disk->disk_name, "iosim0");
+	set_capacity(dev->disk, (sector_t)iosim_size_mb << (20 - 9));
+	add_disk(dev->disk);
+
+	return 0;
+
+out_queue:
+	blk_cleanup_queue(dev->queue);
+out_unregister:
+	unregister_blkdev(dev->major, "iosim");
+out_cache:
+	kmem_cache_destroy(iosim_cmd_cache);
+	return ret;
+}
+
+static void __exit iosim_exit(void)
+{
+	struct iosim_device *dev = &iosim_dev;
+
+	del_gendisk(dev->disk);
+	blk_cleanup_queue(dev->queue);
+	hrtimer_cancel(&dev->timer);
+	put_disk(dev->disk);
+	unregister_blkdev(dev->major, "iosim");
+	kmem_cache_destroy(iosim_cmd_cache);
+}
+
+module_init(iosim_init);
+module_exit(iosim_exit);
+
+MODULE_DESCRIPTION("Simulated block device for I/O scheduler evaluation");
+MODULE_LICENSE("GPL");
@@ -18,21 +18,77 @@
 #include <linux/cpufreq.h>
 #include <linux/cpumask.h>
 #include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/module.h>
 #include <linux/percpu.h>
+#include <linux/smp.h>
 #include <linux/types.h>
 
 #include <trace/events/power.h>
 
 #include "cpu_load_metric.h"
+#ifdef CONFIG_PMU_COREMEM_RATIO
+#include "pmu_func.h"
+#endif
 
+/*
+ * Besides the plain busy percentage every CPU keeps a frequency invariant
+ * load, in percent of its capacity at the highest OPP. With the PMU
+ * counters of pmu_count.c running, the share of busy time spent stalled on
+ * memory is estimated from the L2 refills per instruction (the core:mem
+ * regions of coremem_ratio()) and is accounted as if it ran at the lowest
+ * OPP, since a higher clock does not make those stalls any shorter.
+ */
 struct cpu_load
 {
 	unsigned int frequency;
 	unsigned int load;
+	unsigned int inv_load;
+	unsigned int stall;
+	int region;
 	u64 last_update;
 };
 static DEFINE_PER_CPU(struct cpu_load, cpuload);
 
+static bool stall_aware = true;
+module_param(stall_aware, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(stall_aware, "Discount memory stalls from the invariant load");
+
+#ifdef CONFIG_PMU_COREMEM_RATIO
+/*
+ * Must run on @cpu. The counters are reset on every read, the same way
+ * read_pmu_one() does, so each sample covers one governor window.
+ */
+static void update_pmu_metric(int cpu, struct cpu_load *pcpuload)
+{
+	struct pmu_count_value pmu_data;
+	unsigned int stall;
+
+	/* counters not started yet or lost in a cpu power down */
+	if (!is_alive_cpu(cpu) || !(read_pmnc() & 0x1)) {
+		start_counter_cpu(cpu);
+		pcpuload->region = 0;
+		pcpuload->stall = 0;
+		return;
+	}
+
+	pmu_data.core_num = cpu;
+	pmu_data.valid = 0;
+	read_pmu_one(&pmu_data);
+	if (!pmu_data.valid)
+		return;
+
+	/* pmnc1 counts instructions and pmnc2 L2 refills, see pmu_count.c */
+	pcpuload->region = coremem_ratio(pmu_data.pmnc1, pmu_data.pmnc2);
+
+	/* middle of the region's memory share, e.g. region 2 is 20..40% */
+	stall = pcpuload->region ? pcpuload->region * 20 - 10 : 0;
+	pcpuload->stall = (pcpuload->stall + stall) / 2;
+}
+#else
+static inline void update_pmu_metric(int cpu, struct cpu_load *pcpuload) { }
+#endif
+
 void update_cpu_metric(int cpu, u64 now, u64 delta_idle, u64 delta_time,
 		       struct cpufreq_policy *policy)
 {
@@ -49,14 +105,45 @@ void update_cpu_metric(int cpu, u64 now, u64 delta_idle, u64 delta_time,
 	else
 		load = div64_u64((100 * (delta_time - delta_idle)), delta_time);
 
+	/* the PMU can only be read from the CPU it belongs to */
+	if (cpu == get_cpu())
+		update_pmu_metric(cpu, pcpuload);
+	put_cpu();
+
 	pcpuload->load = load;
 	pcpuload->frequency = policy->cur;
+	pcpuload->inv_load = cpu_load_metric_adjust_freq(cpu, load * policy->cur,
+					policy) / policy->cpuinfo.max_freq;
 	pcpuload->last_update = now;
 #ifdef CONFIG_CPU_THERMAL_IPA_DEBUG
-	trace_printk("cpu_load: cpu: %d freq: %u load: %u\n", cpu, policy->cur, load);
+	trace_printk("cpu_load: cpu: %d freq: %u load: %u inv_load: %u stall: %u\n",
+		     cpu, policy->cur, load, pcpuload->inv_load, pcpuload->stall);
 #endif
 }
 
+/*
+ * Scale a governor's load * cur_freq product so that the busy time stalled
+ * on memory only asks for policy->min. Returns @loadadjfreq unchanged when
+ * no stall estimate is available.
+ */
+unsigned int cpu_load_metric_adjust_freq(int cpu, unsigned int loadadjfreq,
+					 struct cpufreq_policy *policy)
+{
+	unsigned int stall = per_cpu(cpuload, cpu).stall;
+	unsigned int cur = policy->cur;
+
+	if (!stall_aware || !stall || !cur || cur <= policy->min)
+		return loadadjfreq;
+
+	return loadadjfreq - div_u64((u64)loadadjfreq * stall * (cur - policy->min),
+				     100 * cur);
+}
+
+int cpu_load_metric_get_region(int cpu)
+{
+	return per_cpu(cpuload, cpu).region;
+}
+
 void cpu_load_metric_get(int *load, int *freq)
 {
 	int _load = 0, _freq = 0;
@@ -75,7 +162,7 @@ void cpu_load_metric_get(int *load, int *freq)
 
 static void get_cluster_stat(struct cluster_stats *cl)
 {
-	int util = 0, freq = 0;
+	int util = 0, inv_util = 0, freq = 0;
 	int cpu, i = 0;
 
 	for_each_cpu(cpu, cl->mask) {
@@ -83,11 +170,14 @@ static void get_cluster_stat(struct cluster_stats *cl)
 		int load = (cpu_online(cpu)) ?  pcpuload->load : 0;
 
 		util += load;
+		if (cpu_online(cpu))
+			inv_util += pcpuload->inv_load;
 		cl->utils[i++] = load;
 		freq = pcpuload->frequency;
 	}
 
 	cl->util = util;
+	cl->inv_util = inv_util;
 	cl->freq = freq;
 }
 
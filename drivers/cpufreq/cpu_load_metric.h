@@ -25,6 +25,8 @@ struct cluster_stats
 {
 	int util;
 	int utils[NR_CPUS];
+	/* sum of the frequency invariant loads, in % of max capacity */
+	int inv_util;
 	int freq;
 	cpumask_var_t mask;
 };
@@ -32,6 +34,9 @@ struct cluster_stats
 void update_cpu_metric(int cpu, u64 now, u64 delta_idle, u64 delta_time, struct cpufreq_policy *policy);
 
 void cpu_load_metric_get(int *load, int *freq);
+unsigned int cpu_load_metric_adjust_freq(int cpu, unsigned int loadadjfreq,
+					 struct cpufreq_policy *policy);
+int cpu_load_metric_get_region(int cpu);
 void get_cluster_stats(struct cluster_stats *clstats);
 
 #endif /* _DRIVERS_CPU_LOAD_METRIC_H */
@@ -0,0 +1,491 @@
+/*
+ * drivers/cpufreq/cpufreq_input_boost.c
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Input event driven CPU boost, shared by all governors.
+ *
+ * On a touch or key event the minimum frequency of both clusters is raised
+ * through the cluster pm_qos classes, and optionally the HMP scheduler is
+ * asked to semiboost or boost, for duration_ms after the last event. The
+ * boost is applied to a cluster only when its current governor is listed
+ * in "governors", so governors opt in by name instead of each one carrying
+ * its own partial boost tunables.
+ *
+ * Tunables and statistics are in /sys/devices/system/cpu/cpufreq/input_boost.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/input.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/pm_qos.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#include <mach/cpufreq.h>
+
+#define DEFAULT_DURATION_MS		100
+#define DEFAULT_CLUSTER0_FREQ		1200000
+#define DEFAULT_CLUSTER1_FREQ		1000000
+#define DEFAULT_GOVERNORS	"interactive interextrem sched alucard nightmare darkness lionheart"
+
+#define GOVERNORS_LEN			(CPUFREQ_NAME_LEN * 16)
+
+enum {
+	HMP_BOOST_NONE,
+	HMP_BOOST_SEMI,
+	HMP_BOOST_FULL,
+};
+
+static unsigned int boost_enabled = 1;
+static unsigned int boost_duration_ms = DEFAULT_DURATION_MS;
+static unsigned int boost_freq[CL_END] = {
+	[CL_ZERO] = DEFAULT_CLUSTER0_FREQ,
+	[CL_ONE] = DEFAULT_CLUSTER1_FREQ,
+};
+static unsigned int boost_hmp = HMP_BOOST_SEMI;
+static char boost_governors[GOVERNORS_LEN] = DEFAULT_GOVERNORS;
+
+static const int boost_qos_class[CL_END] = {
+	[CL_ZERO] = PM_QOS_CLUSTER0_FREQ_MIN,
+	[CL_ONE] = PM_QOS_CLUSTER1_FREQ_MIN,
+};
+static struct pm_qos_request boost_qos[CL_END];
+
+/* serializes boost/unboost and the tunables they read */
+static DEFINE_MUTEX(boost_mutex);
+
+static DEFINE_SPINLOCK(boost_lock);	/* protects the fields below */
+static bool boost_active;
+static bool boost_pending;
+static unsigned long boost_start;	/* jiffies */
+static unsigned long stat_events;	/* touch reports and key presses */
+static unsigned long stat_boosts;	/* boosts started */
+static unsigned long stat_hits;		/* events that extended a boost */
+static unsigned long stat_skipped;	/* no cluster had an opted in governor */
+static u64 stat_boost_ms;		/* total time boosted */
+
+static bool boost_hmp_semi_held;
+
+static void input_boost_fn(struct work_struct *work);
+static void input_unboost_fn(struct work_struct *work);
+static DECLARE_WORK(boost_work, input_boost_fn);
+static DECLARE_DELAYED_WORK(unboost_work, input_unboost_fn);
+
+static inline cluster_type cpu_to_cluster(unsigned int cpu)
+{
+	return cpu < NR_CLUST0_CPUS ? CL_ZERO : CL_ONE;
+}
+
+/* called with boost_mutex held */
+static bool governor_opted_in(const char *name)
+{
+	size_t len = strlen(name);
+	const char *p = boost_governors;
+
+	while (*p) {
+		p = skip_spaces(p);
+		if (!strncmp(p, name, len) && (p[len] == ' ' || p[len] == '\0' ||
+					       p[len] == '\n'))
+			return true;
+		p += strcspn(p, " ");
+	}
+
+	return false;
+}
+
+/* called with boost_mutex held */
+static bool cluster_opted_in(cluster_type cl)
+{
+	struct cpufreq_policy *policy;
+	bool ret = false;
+	unsigned int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		if (cpu_to_cluster(cpu) != cl)
+			continue;
+
+		policy = cpufreq_cpu_get(cpu);
+		if (!policy)
+			break;
+		if (policy->governor)
+			ret = governor_opted_in(policy->governor->name);
+		cpufreq_cpu_put(policy);
+		break;
+	}
+	put_online_cpus();
+
+	return ret;
+}
+
+static void input_boost_fn(struct work_struct *work)
+{
+	unsigned long flags;
+	bool boosted = false;
+	cluster_type cl;
+
+	mutex_lock(&boost_mutex);
+
+	for (cl = 0; cl < CL_END; cl++) {
+		if (!boost_freq[cl] || !cluster_opted_in(cl))
+			continue;
+		pm_qos_update_request(&boost_qos[cl], boost_freq[cl]);
+		boosted = true;
+	}
+
+#ifdef CONFIG_SCHED_HMP
+	if (boosted) {
+		if (boost_hmp == HMP_BOOST_SEMI && !boost_hmp_semi_held)
+			boost_hmp_semi_held = !set_hmp_semiboost(1);
+		else if (boost_hmp == HMP_BOOST_FULL)
+			set_hmp_boostpulse(boost_duration_ms * USEC_PER_MSEC);
+	}
+#endif
+
+	spin_lock_irqsave(&boost_lock, flags);
+	boost_pending = false;
+	if (boosted) {
+		boost_active = true;
+		boost_start = jiffies;
+		stat_boosts++;
+	} else {
+		stat_skipped++;
+	}
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	if (boosted)
+		mod_delayed_work(system_wq, &unboost_work,
+				 msecs_to_jiffies(boost_duration_ms));
+
+	mutex_unlock(&boost_mutex);
+}
+
+static void input_unboost_fn(struct work_struct *work)
+{
+	unsigned long flags;
+	cluster_type cl;
+
+	mutex_lock(&boost_mutex);
+
+	/*
+	 * Decide under boost_lock first: an event in the window before we got
+	 * here may have counted a hit and re-armed us, and then the boost has
+	 * to stay. Once boost_active is clear, new events queue a fresh boost,
+	 * which waits for boost_mutex and so lands after the requests drop.
+	 */
+	spin_lock_irqsave(&boost_lock, flags);
+	if (boost_active && delayed_work_pending(&unboost_work)) {
+		spin_unlock_irqrestore(&boost_lock, flags);
+		mutex_unlock(&boost_mutex);
+		return;
+	}
+	if (boost_active)
+		stat_boost_ms += jiffies_to_msecs(jiffies - boost_start);
+	boost_active = false;
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	for (cl = 0; cl < CL_END; cl++)
+		pm_qos_update_request(&boost_qos[cl], 0);
+
+#ifdef CONFIG_SCHED_HMP
+	if (boost_hmp_semi_held) {
+		set_hmp_semiboost(0);
+		boost_hmp_semi_held = false;
+	}
+#endif
+
+	mutex_unlock(&boost_mutex);
+}
+
+#define BOOST_KEY_ID(key)						\
+	{								\
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |			\
+			 INPUT_DEVICE_ID_MATCH_KEYBIT,			\
+		.evbit = { BIT_MASK(EV_KEY) },				\
+		.keybit = { [BIT_WORD(key)] = BIT_MASK(key) },		\
+	}
+
+static const struct input_device_id input_boost_ids[] = {
+	/* multi-touch touchscreen */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	/* touchpad */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	/* keys that open or switch the UI, not volume or headset buttons */
+	BOOST_KEY_ID(KEY_POWER),
+	BOOST_KEY_ID(KEY_HOMEPAGE),
+	BOOST_KEY_ID(KEY_BACK),
+	BOOST_KEY_ID(KEY_RECENT),
+	{ },
+};
+
+/* BTN_TOUCH or one of the keys listed above */
+static bool boost_key(unsigned int code)
+{
+	const struct input_device_id *id;
+
+	for (id = input_boost_ids; id->flags; id++)
+		if ((id->flags & INPUT_DEVICE_ID_MATCH_KEYBIT) &&
+		    test_bit(code, id->keybit))
+			return true;
+
+	return false;
+}
+
+/*
+ * Touch devices count once per report, so a moving finger is not counted
+ * once per axis update, and every device counts the press of a boost key.
+ * Other keys of a matched device, e.g. volume on gpio-keys, are ignored.
+ */
+static bool boost_trigger(struct input_handle *handle, unsigned int type,
+			  unsigned int code, int value)
+{
+	if (type == EV_KEY)
+		return value == 1 && boost_key(code);
+
+	return type == EV_SYN && code == SYN_REPORT &&
+	       test_bit(EV_ABS, handle->dev->evbit);
+}
+
+/* atomic context, under the input device's event lock */
+static void input_boost_event(struct input_handle *handle, unsigned int type,
+			      unsigned int code, int value)
+{
+	unsigned long flags;
+
+	if (!boost_trigger(handle, type, code, value))
+		return;
+
+	spin_lock_irqsave(&boost_lock, flags);
+	stat_events++;
+
+	if (!boost_enabled || boost_pending)
+		goto out;
+
+	if (boost_active) {
+		stat_hits++;
+		mod_delayed_work(system_wq, &unboost_work,
+				 msecs_to_jiffies(boost_duration_ms));
+#ifdef CONFIG_SCHED_HMP
+		if (boost_hmp == HMP_BOOST_FULL)
+			set_hmp_boostpulse(boost_duration_ms * USEC_PER_MSEC);
+#endif
+		goto out;
+	}
+
+	boost_pending = true;
+	queue_work(system_wq, &boost_work);
+out:
+	spin_unlock_irqrestore(&boost_lock, flags);
+}
+
+static int input_boost_connect(struct input_handler *handler,
+			       struct input_dev *dev,
+			       const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "input_boost";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_register;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_open;
+
+	return 0;
+
+err_open:
+	input_unregister_handle(handle);
+err_register:
+	kfree(handle);
+	return error;
+}
+
+static void input_boost_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static struct input_handler input_boost_handler = {
+	.event		= input_boost_event,
+	.connect	= input_boost_connect,
+	.disconnect	= input_boost_disconnect,
+	.name		= "input_boost",
+	.id_table	= input_boost_ids,
+};
+
+/* drop a boost in progress so that new tunables take effect */
+static void input_boost_flush(void)
+{
+	unsigned long flags;
+
+	cancel_work_sync(&boost_work);
+	spin_lock_irqsave(&boost_lock, flags);
+	boost_pending = false;
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	mod_delayed_work(system_wq, &unboost_work, 0);
+	flush_delayed_work(&unboost_work);
+}
+
+#define show_one(file_name, object)					\
+static ssize_t show_##file_name(struct kobject *kobj,			\
+				struct attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", object);				\
+}
+
+#define store_one(file_name, object, max_val)				\
+static ssize_t store_##file_name(struct kobject *kobj,		\
+		struct attribute *attr, const char *buf, size_t count)	\
+{									\
+	unsigned int val;						\
+									\
+	if (kstrtouint(buf, 0, &val) || val > (max_val))		\
+		return -EINVAL;						\
+									\
+	input_boost_flush();						\
+	mutex_lock(&boost_mutex);					\
+	object = val;							\
+	mutex_unlock(&boost_mutex);					\
+	return count;							\
+}
+
+show_one(enabled, boost_enabled);
+show_one(duration_ms, boost_duration_ms);
+show_one(cluster0_freq, boost_freq[CL_ZERO]);
+show_one(cluster1_freq, boost_freq[CL_ONE]);
+show_one(hmp_boost, boost_hmp);
+
+store_one(enabled, boost_enabled, 1);
+store_one(duration_ms, boost_duration_ms, 5000);
+store_one(cluster0_freq, boost_freq[CL_ZERO], UINT_MAX);
+store_one(cluster1_freq, boost_freq[CL_ONE], UINT_MAX);
+store_one(hmp_boost, boost_hmp, HMP_BOOST_FULL);
+
+static ssize_t show_governors(struct kobject *kobj,
+			      struct attribute *attr, char *buf)
+{
+	ssize_t ret;
+
+	mutex_lock(&boost_mutex);
+	ret = sprintf(buf, "%s\n", boost_governors);
+	mutex_unlock(&boost_mutex);
+
+	return ret;
+}
+
+static ssize_t store_governors(struct kobject *kobj,
+		struct attribute *attr, const char *buf, size_t count)
+{
+	if (count >= GOVERNORS_LEN)
+		return -EINVAL;
+
+	input_boost_flush();
+	mutex_lock(&boost_mutex);
+	strlcpy(boost_governors, buf, GOVERNORS_LEN);
+	strim(boost_governors);
+	mutex_unlock(&boost_mutex);
+
+	return count;
+}
+
+static ssize_t show_stats(struct kobject *kobj,
+			  struct attribute *attr, char *buf)
+{
+	unsigned long flags;
+	ssize_t ret;
+
+	spin_lock_irqsave(&boost_lock, flags);
+	ret = sprintf(buf, "events %lu boosts %lu hits %lu skipped %lu boost_ms %llu\n",
+		      stat_events, stat_boosts, stat_hits, stat_skipped,
+		      stat_boost_ms);
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	return ret;
+}
+
+define_one_global_rw(enabled);
+define_one_global_rw(duration_ms);
+define_one_global_rw(cluster0_freq);
+define_one_global_rw(cluster1_freq);
+define_one_global_rw(hmp_boost);
+define_one_global_rw(governors);
+define_one_global_ro(stats);
+
+static struct attribute *input_boost_attributes[] = {
+	&enabled.attr,
+	&duration_ms.attr,
+	&cluster0_freq.attr,
+	&cluster1_freq.attr,
+	&hmp_boost.attr,
+	&governors.attr,
+	&stats.attr,
+	NULL,
+};
+
+static struct attribute_group input_boost_attr_group = {
+	.attrs = input_boost_attributes,
+	.name = "input_boost",
+};
+
+static int __init cpufreq_input_boost_init(void)
+{
+	cluster_type cl;
+	int ret;
+
+	for (cl = 0; cl < CL_END; cl++)
+		pm_qos_add_request(&boost_qos[cl], boost_qos_class[cl], 0);
+
+	ret = input_register_handler(&input_boost_handler);
+	if (ret)
+		goto err_handler;
+
+	ret = sysfs_create_group(cpufreq_global_kobject, &input_boost_attr_group);
+	if (ret)
+		pr_warn("cpufreq_input_boost: failed to create sysfs group\n");
+
+	return 0;
+
+err_handler:
+	for (cl = 0; cl < CL_END; cl++)
+		pm_qos_remove_request(&boost_qos[cl]);
+	return ret;
+}
+late_initcall(cpufreq_input_boost_init);
@@ -675,6 +675,14 @@ static void exit_mode(struct cpufreq_interactive_tunables * tunables)
 }
 #endif
 
+static unsigned long floor_hold_time(struct cpufreq_interactive_cpuinfo *pcpu,
+		struct cpufreq_interactive_tunables *tunables, unsigned int new_freq)
+{
+	return tunables->min_sample_time +
+	       exynos_cpufreq_hold_time(pcpu->policy, pcpu->policy->cur,
+					new_freq);
+}
+
 static void cpufreq_interactive_timer(unsigned long data)
 {
 	u64 now;
@@ -693,7 +701,6 @@ static void cpufreq_interactive_timer(unsigned long data)
 	unsigned int new_mode;
 #endif
 #ifdef CONFIG_PMU_COREMEM_RATIO
-	struct pmu_count_value pmu_data;
 	int region = 0;
 #endif
 	if (!down_read_trylock(&pcpu->enable_sem))
@@ -730,18 +737,16 @@ static void cpufreq_interactive_timer(unsigned long data)
 	spin_lock_irqsave(&pcpu->target_freq_lock, flags);
 	do_div(cputime_speedadj, delta_time);
 	loadadjfreq = (unsigned int)cputime_speedadj * 100;
+	/* time stalled on memory does not need a higher clock */
+	loadadjfreq = cpu_load_metric_adjust_freq(data, loadadjfreq,
+						  pcpu->policy);
 	cpu_load = loadadjfreq / pcpu->policy->cur;
 	tunables->boosted = tunables->boost_val || now < tunables->boostpulse_endtime;
 
 #ifdef CONFIG_PMU_COREMEM_RATIO
-	/* Get crypto load information from PMU */
-	pmu_data.core_num = data;
-	pmu_data.valid = 0;
-
-	read_pmu_one(&pmu_data);
-
+	/* sampled from the PMU by update_cpu_metric() in update_load() */
 	pcpu->prev_region = pcpu->region;
-	region = coremem_ratio(pmu_data.pmnc1, pmu_data.pmnc2);
+	region = cpu_load_metric_get_region(data);
 	if (region != pcpu->prev_region) {
 		pcpu->region = region;
 		spin_lock_irqsave(&regionchange_cpumask_lock, flags);
@@ -802,7 +807,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	 */
 	if (new_freq < pcpu->floor_freq) {
 		if (now - pcpu->floor_validate_time <
-				tunables->min_sample_time) {
+				floor_hold_time(pcpu, tunables, new_freq)) {
 			trace_cpufreq_interactive_notyet(
 				data, cpu_load, pcpu->target_freq,
 				pcpu->policy->cur, new_freq);
@@ -0,0 +1,387 @@
+/*
+ * drivers/cpufreq/cpufreq_sched.c
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Scheduler driven cpufreq governor.
+ *
+ * There is no sampling timer: the fair class reports the utilization of
+ * a CPU (0..1024, from the per-entity load tracking) on every enqueue,
+ * dequeue and tick through cpufreq_sched_update_util(). The highest
+ * utilization of the policy's CPUs is turned into a frequency with some
+ * headroom and, if that moves the OPP, an irq_work wakes a SCHED_FIFO
+ * thread that performs the change. The thread is needed because the
+ * Exynos driver takes a mutex and programs the PMIC to switch OPP, which
+ * cannot be done with the rq lock held.
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/cpumask.h>
+#include <linux/irq_work.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/sched/rt.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#ifdef CONFIG_ARM_EXYNOS_MP_CPUFREQ
+#include <mach/cpufreq.h>
+#endif
+
+/* raise quickly, but keep a short sleep from dropping the clock */
+#define DEFAULT_UP_RATE_LIMIT_US	500
+#define DEFAULT_DOWN_RATE_LIMIT_US	20000
+/* run at a frequency where the current load would fill 80% of the CPU */
+#define DEFAULT_HEADROOM_PCT		125
+
+struct cpufreq_sched_policy {
+	struct cpufreq_policy *policy;
+
+	raw_spinlock_t lock;		/* protects the fields below */
+	u64 last_change;		/* sched_clock() of the last request */
+	unsigned int requested_freq;
+	bool pending;
+
+	struct irq_work irq_work;
+	struct task_struct *task;
+};
+
+struct cpufreq_sched_cpu {
+	unsigned long util;
+	u64 last_update;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_sched_policy *, cpufreq_sched_policy);
+static DEFINE_PER_CPU(struct cpufreq_sched_cpu, cpufreq_sched_cpu);
+
+static unsigned int sched_up_rate_limit_us = DEFAULT_UP_RATE_LIMIT_US;
+static unsigned int sched_down_rate_limit_us = DEFAULT_DOWN_RATE_LIMIT_US;
+static unsigned int sched_headroom_pct = DEFAULT_HEADROOM_PCT;
+
+static DEFINE_MUTEX(gov_lock);
+static int active_count;
+
+static unsigned int cpufreq_sched_resolve(struct cpufreq_policy *policy,
+					  unsigned int freq)
+{
+#ifdef CONFIG_ARM_EXYNOS_MP_CPUFREQ
+	return exynos_cpufreq_resolve(policy, freq);
+#else
+	struct cpufreq_frequency_table *table;
+	unsigned int index;
+
+	freq = clamp(freq, policy->min, policy->max);
+	table = cpufreq_frequency_get_table(policy->cpu);
+	if (!table || cpufreq_frequency_table_target(policy, table, freq,
+						     CPUFREQ_RELATION_L, &index))
+		return freq;
+
+	return table[index].frequency;
+#endif
+}
+
+static unsigned int cpufreq_sched_next_freq(struct cpufreq_policy *policy,
+					    unsigned long util)
+{
+	u64 freq;
+
+	/*
+	 * With frequency invariant load tracking util is relative to the
+	 * capacity at the highest OPP, otherwise to the current one.
+	 */
+#ifdef CONFIG_HMP_FREQUENCY_INVARIANT_SCALE
+	freq = policy->cpuinfo.max_freq;
+#else
+	freq = policy->cur;
+#endif
+	freq = div_u64(freq * util * sched_headroom_pct, SCHED_POWER_SCALE * 100);
+
+	return cpufreq_sched_resolve(policy, (unsigned int)freq);
+}
+
+/*
+ * Called from the fair class with the rq lock of @cpu held and interrupts
+ * disabled. Nothing here may sleep or take a lock the rq lock nests in.
+ */
+void cpufreq_sched_update_util(int cpu, unsigned long util)
+{
+	struct cpufreq_sched_policy *sp = per_cpu(cpufreq_sched_policy, cpu);
+	struct cpufreq_sched_cpu *sc = &per_cpu(cpufreq_sched_cpu, cpu);
+	struct cpufreq_policy *policy;
+	unsigned long max_util = 0;
+	unsigned int freq, cur, j;
+	u64 now, limit;
+
+	if (!sp)
+		return;
+
+	now = sched_clock();
+	sc->util = util;
+	sc->last_update = now;
+	policy = sp->policy;
+
+	raw_spin_lock(&sp->lock);
+
+	for_each_cpu(j, policy->cpus) {
+		struct cpufreq_sched_cpu *jc = &per_cpu(cpufreq_sched_cpu, j);
+
+		/* a CPU that stopped ticking is idle, its last report is stale */
+		if (now - jc->last_update > TICK_NSEC)
+			continue;
+		max_util = max(max_util, jc->util);
+	}
+
+	freq = cpufreq_sched_next_freq(policy, max_util);
+	cur = sp->pending ? sp->requested_freq : policy->cur;
+	if (freq == cur)
+		goto out;
+
+	limit = freq > cur ? sched_up_rate_limit_us :
+			     sched_down_rate_limit_us;
+#ifdef CONFIG_ARM_EXYNOS_MP_CPUFREQ
+	/* raising is paid back by the load itself, dropping has to pay off */
+	if (freq < cur)
+		limit += exynos_cpufreq_hold_time(policy, cur, freq);
+#endif
+	if (now - sp->last_change < limit * NSEC_PER_USEC)
+		goto out;
+
+	sp->requested_freq = freq;
+	sp->last_change = now;
+	if (!sp->pending) {
+		sp->pending = true;
+		irq_work_queue(&sp->irq_work);
+	}
+out:
+	raw_spin_unlock(&sp->lock);
+}
+
+static void cpufreq_sched_irq_work(struct irq_work *irq_work)
+{
+	struct cpufreq_sched_policy *sp =
+		container_of(irq_work, struct cpufreq_sched_policy, irq_work);
+
+	wake_up_process(sp->task);
+}
+
+static int cpufreq_sched_thread(void *data)
+{
+	struct cpufreq_sched_policy *sp = data;
+	unsigned long flags;
+	unsigned int freq;
+	bool pending;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+
+		raw_spin_lock_irqsave(&sp->lock, flags);
+		pending = sp->pending;
+		freq = sp->requested_freq;
+		raw_spin_unlock_irqrestore(&sp->lock, flags);
+
+		if (!pending) {
+			if (kthread_should_stop())
+				break;
+			schedule();
+			continue;
+		}
+
+		__set_current_state(TASK_RUNNING);
+		if (freq != sp->policy->cur)
+			__cpufreq_driver_target(sp->policy, freq,
+						CPUFREQ_RELATION_L);
+
+		/* a newer request that came in meanwhile is picked up next */
+		raw_spin_lock_irqsave(&sp->lock, flags);
+		if (sp->requested_freq == freq)
+			sp->pending = false;
+		raw_spin_unlock_irqrestore(&sp->lock, flags);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+#define show_one(file_name, object)					\
+static ssize_t show_##file_name(struct kobject *kobj,			\
+				struct attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", object);				\
+}
+
+show_one(up_rate_limit_us, sched_up_rate_limit_us);
+show_one(down_rate_limit_us, sched_down_rate_limit_us);
+show_one(headroom_pct, sched_headroom_pct);
+
+static ssize_t store_up_rate_limit_us(struct kobject *kobj,
+		struct attribute *attr, const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val))
+		return -EINVAL;
+	sched_up_rate_limit_us = val;
+	return count;
+}
+
+static ssize_t store_down_rate_limit_us(struct kobject *kobj,
+		struct attribute *attr, const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val))
+		return -EINVAL;
+	sched_down_rate_limit_us = val;
+	return count;
+}
+
+static ssize_t store_headroom_pct(struct kobject *kobj,
+		struct attribute *attr, const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val) || val < 100 || val > 400)
+		return -EINVAL;
+	sched_headroom_pct = val;
+	return count;
+}
+
+define_one_global_rw(up_rate_limit_us);
+define_one_global_rw(down_rate_limit_us);
+define_one_global_rw(headroom_pct);
+
+static struct attribute *cpufreq_sched_attributes[] = {
+	&up_rate_limit_us.attr,
+	&down_rate_limit_us.attr,
+	&headroom_pct.attr,
+	NULL,
+};
+
+static struct attribute_group cpufreq_sched_attr_group = {
+	.attrs = cpufreq_sched_attributes,
+	.name = "sched",
+};
+
+static int cpufreq_sched_start(struct cpufreq_policy *policy)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO - 1 };
+	struct cpufreq_sched_policy *sp;
+	unsigned int j;
+	int rc = 0;
+
+	sp = kzalloc(sizeof(*sp), GFP_KERNEL);
+	if (!sp)
+		return -ENOMEM;
+
+	sp->policy = policy;
+	sp->requested_freq = policy->cur;
+	raw_spin_lock_init(&sp->lock);
+	init_irq_work(&sp->irq_work, cpufreq_sched_irq_work);
+
+	sp->task = kthread_create(cpufreq_sched_thread, sp, "cfsched%d",
+				  policy->cpu);
+	if (IS_ERR(sp->task)) {
+		rc = PTR_ERR(sp->task);
+		kfree(sp);
+		return rc;
+	}
+	sched_setscheduler_nocheck(sp->task, SCHED_FIFO, &param);
+	get_task_struct(sp->task);
+	wake_up_process(sp->task);
+
+	mutex_lock(&gov_lock);
+	if (!active_count++) {
+		rc = sysfs_create_group(cpufreq_global_kobject,
+					&cpufreq_sched_attr_group);
+		if (rc)
+			pr_warn("cpufreq_sched: failed to create sysfs group\n");
+	}
+	mutex_unlock(&gov_lock);
+
+	policy->governor_data = sp;
+	for_each_cpu(j, policy->cpus)
+		per_cpu(cpufreq_sched_policy, j) = sp;
+
+	return 0;
+}
+
+static void cpufreq_sched_stop(struct cpufreq_policy *policy)
+{
+	struct cpufreq_sched_policy *sp = policy->governor_data;
+	unsigned int j;
+
+	if (!sp)
+		return;
+
+	for_each_cpu(j, policy->cpus)
+		per_cpu(cpufreq_sched_policy, j) = NULL;
+
+	/* updates run with the rq lock held, i.e. in a sched RCU section */
+	synchronize_sched();
+	irq_work_sync(&sp->irq_work);
+
+	kthread_stop(sp->task);
+	put_task_struct(sp->task);
+	policy->governor_data = NULL;
+	kfree(sp);
+
+	mutex_lock(&gov_lock);
+	if (!--active_count)
+		sysfs_remove_group(cpufreq_global_kobject,
+				   &cpufreq_sched_attr_group);
+	mutex_unlock(&gov_lock);
+}
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+				  unsigned int event)
+{
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		return cpufreq_sched_start(policy);
+
+	case CPUFREQ_GOV_STOP:
+		cpufreq_sched_stop(policy);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->max, CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->min, CPUFREQ_RELATION_L);
+		break;
+	}
+	return 0;
+}
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+static
+#endif
+struct cpufreq_governor cpufreq_gov_sched = {
+	.name = "sched",
+	.governor = cpufreq_governor_sched,
+	.owner = THIS_MODULE,
+};
+
+static int __init cpufreq_sched_init(void)
+{
+	return cpufreq_register_governor(&cpufreq_gov_sched);
+}
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+fs_initcall(cpufreq_sched_init);
+#else
+module_init(cpufreq_sched_init);
+#endif
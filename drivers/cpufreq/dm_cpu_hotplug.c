@@ -91,6 +91,42 @@ static bool cluster0_core_in_by_nr_running = false;
 static unsigned int cluster1_min_freq;
 static unsigned int cluster0_max_freq;
 #endif
+
+/*
+ * Load prediction. Each poll samples the runqueue length (avg_nr_running(),
+ * in 1/100 tasks) and the average busy percentage of the online CPUs of
+ * cluster0, smooths their per-poll change into a trend and extrapolates both
+ * predict_lookahead polls ahead. When the extrapolation says the online CPUs
+ * will not cope, the offline ones are brought in now rather than after
+ * cur_load_freq has caught up, and a rising trend halves the poll period so
+ * the next decision comes sooner. A lookahead of 0 disables prediction.
+ */
+#define DEFAULT_PREDICT_LOOKAHEAD	2
+#define DEFAULT_PREDICT_UTIL		80
+static unsigned int predict_lookahead = DEFAULT_PREDICT_LOOKAHEAD;
+static unsigned int predict_util_threshold = DEFAULT_PREDICT_UTIL;
+static unsigned int cur_nr_avg, cur_util_avg;
+static int nr_trend, util_trend;
+static bool demand_predicted;
+
+/*
+ * Bringing a core in with cpu_up() takes tens of milliseconds, waking it from
+ * C2 with its cluster powered down (CPD) well under one. While the LCD is on
+ * the system never enters LPM anyway, so rather than hotplugging the cluster1
+ * cores out for low power mode, keep them online and idle and let cpuidle
+ * power the cluster down. With the LCD off they are still hotplugged out, as
+ * LPM requires every non-boot core to be offline.
+ *
+ * diagnose_condition() only picks low power mode with the LCD on when the
+ * hotplug is forced, i.e. by decon display hibernation through
+ * force_dynamic_hotplug(), so that is the only path this affects; without
+ * it, the LCD on mode is never low power and cluster1 stays online anyway.
+ */
+static bool fast_cluster_off = true;
+#if defined(CONFIG_SCHED_HMP)
+static bool cluster1_parked = false;
+#endif
+
 int disable_dm_hotplug_before_suspend = 0;
 int nr_sleep_prepare_cpus = CONFIG_EXYNOS5_DYNAMIC_CPU_HOTPLUG_SLEEP_PREPARE;
 
@@ -346,6 +382,55 @@ static ssize_t store_dm_hotplug_delay(struct kobject *kobj, struct attribute *at
 	return count;
 }
 
+static ssize_t show_dm_hotplug_predict(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "lookahead = %u, util_threshold = %u, "
+			"nr_avg = %u (%+d), util_avg = %u (%+d), predicted = %d\n",
+			predict_lookahead, predict_util_threshold,
+			cur_nr_avg, nr_trend, cur_util_avg, util_trend,
+			demand_predicted);
+}
+
+static ssize_t store_dm_hotplug_predict(struct kobject *kobj,
+				struct attribute *attr, const char *buf, size_t count)
+{
+	int input_lookahead, input_util;
+
+	if (sscanf(buf, "%8d %8d", &input_lookahead, &input_util) != 2)
+		return -EINVAL;
+
+	if (input_lookahead < 0 || input_util <= 0 || input_util > 100) {
+		pr_err("%s: invalid values (lookahead = %d, util = %d)\n",
+			__func__, input_lookahead, input_util);
+		return -EINVAL;
+	}
+
+	predict_lookahead = (unsigned int)input_lookahead;
+	predict_util_threshold = (unsigned int)input_util;
+
+	return count;
+}
+
+static ssize_t show_fast_cluster_off(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", fast_cluster_off);
+}
+
+static ssize_t store_fast_cluster_off(struct kobject *kobj,
+				struct attribute *attr, const char *buf, size_t count)
+{
+	int input;
+
+	if (!sscanf(buf, "%1d", &input))
+		return -EINVAL;
+
+	fast_cluster_off = !!input;
+
+	return count;
+}
+
 static ssize_t show_cpucore_table(struct kobject *kobj,
 			     struct attribute *attr, char *buf)
 {
@@ -453,6 +538,15 @@ static struct global_attr dm_hotplug_delay =
 		__ATTR(dm_hotplug_delay, S_IRUGO | S_IWUSR,
 			show_dm_hotplug_delay, store_dm_hotplug_delay);
 
+static struct global_attr dm_hotplug_predict =
+		__ATTR(dm_hotplug_predict, S_IRUGO | S_IWUSR,
+			show_dm_hotplug_predict, store_dm_hotplug_predict);
+
+/* only acts on forced (display hibernation) low power mode, see above */
+static struct global_attr dm_hotplug_fast_cluster_off =
+		__ATTR(dm_hotplug_fast_cluster_off, S_IRUGO | S_IWUSR,
+			show_fast_cluster_off, store_fast_cluster_off);
+
 static struct sysfs_attr cpucore_table =
 		__ATTR(cpucore_table, S_IRUGO,
 			show_cpucore_table, NULL);
@@ -674,7 +768,16 @@ static int __ref __cpu_hotplug(bool out_flag, enum hotplug_cmd cmd)
 				if (cluster0_hotplug_in)
 					hotplug_out_limit = NR_CLUST0_CPUS - 2;
 
+				cluster1_parked = false;
 				for (i = max_num_cpu - 1; i > hotplug_out_limit; i--) {
+					/* leave cluster1 to cluster power down */
+					if (fast_cluster_off && lcd_is_on &&
+						cmd == CMD_LOW_POWER &&
+						i >= NR_CLUST0_CPUS) {
+						cluster1_parked = true;
+						continue;
+					}
+
 					if (cpu_online(i)) {
 						ret = cpu_down(i);
 						if (ret)
@@ -1051,6 +1154,30 @@ extern bool cluster_on[CL_END];
 #endif
 static int low_stay = 0;
 
+static bool predict_demand(void)
+{
+	unsigned int nr_avg, online = num_online_cpus();
+	int nr_pred, util_pred;
+
+	nr_avg = (avg_nr_running() * 100) >> FSHIFT;
+
+	/* trend is a moving average of the change per poll, weighted 1/4 */
+	nr_trend += ((int)nr_avg - (int)cur_nr_avg - nr_trend) / 4;
+	cur_nr_avg = nr_avg;
+
+	if (!predict_lookahead)
+		return false;
+
+	nr_pred = (int)nr_avg + nr_trend * (int)predict_lookahead;
+	util_pred = (int)cur_util_avg + util_trend * (int)predict_lookahead;
+
+	/* more runnable tasks than CPUs, or the CPUs about to saturate */
+	if (online < max_num_cpu && nr_pred > (int)online * 100)
+		return true;
+
+	return util_pred > (int)predict_util_threshold;
+}
+
 static enum hotplug_cmd diagnose_condition(void)
 {
 	enum hotplug_cmd ret;
@@ -1093,6 +1220,8 @@ static enum hotplug_cmd diagnose_condition(void)
 	update_nr_running_count();
 #endif
 
+	demand_predicted = predict_demand();
+
 #if defined(CONFIG_ARM_EXYNOS_MP_CPUFREQ)
 	ret = CMD_CLUST0_IN;
 
@@ -1131,13 +1260,23 @@ static enum hotplug_cmd diagnose_condition(void)
 	}
 #endif
 
+	if (demand_predicted) {
+		low_stay = 0;
+#if defined(CONFIG_ARM_EXYNOS_MP_CPUFREQ)
+		/* same order as a real load increase, cluster0 first */
+		ret = in_low_power_mode ? CMD_CLUST0_IN : CMD_NORMAL;
+#else
+		ret = CMD_NORMAL;
+#endif
+	}
+
 	return ret;
 }
 
 static void calc_load(void)
 {
 	struct cpufreq_policy *policy;
-	unsigned int cpu_util_sum = 0;
+	unsigned int cpu_util_sum = 0, nr_cpus = 0, util_avg;
 	int cpu = 0;
 	unsigned int i;
 
@@ -1179,6 +1318,7 @@ static void calc_load(void)
 		load = 100 * (wall_time - idle_time) / wall_time;
 		cpu_util[i] = load;
 		cpu_util_sum += load;
+		nr_cpus++;
 
 		load_freq = load * policy->cur;
 
@@ -1187,7 +1327,12 @@ static void calc_load(void)
 	}
 
 	cpufreq_cpu_put(policy);
-	return;
+
+	if (nr_cpus) {
+		util_avg = cpu_util_sum / nr_cpus;
+		util_trend += ((int)util_avg - (int)cur_util_avg - util_trend) / 4;
+		cur_util_avg = util_avg;
+	}
 }
 
 static int on_run(void *data)
@@ -1212,6 +1357,13 @@ static int on_run(void *data)
 			goto sleep;
 		}
 
+#if defined(CONFIG_SCHED_HMP)
+		/* cores left to cluster power down must go before LPM */
+		if (exe_cmd == CMD_LOW_POWER && prev_cmd == CMD_LOW_POWER &&
+			cluster1_parked && !lcd_is_on)
+			prev_cmd = CMD_NORMAL;
+#endif
+
 		if (prev_cmd != exe_cmd) {
 #ifdef DM_HOTPLUG_DEBUG
 			pr_info("frequency info : %d, prev_cmd %d, exe_cmd %d\n",
@@ -1235,7 +1387,10 @@ static int on_run(void *data)
 
 sleep:
 		set_current_state(TASK_INTERRUPTIBLE);
-		schedule_timeout_interruptible(msecs_to_jiffies(delay));
+		if (predict_lookahead && (nr_trend > 0 || util_trend > 0))
+			schedule_timeout_interruptible(msecs_to_jiffies(delay / 2));
+		else
+			schedule_timeout_interruptible(msecs_to_jiffies(delay));
 		set_current_state(TASK_RUNNING);
 	}
 
@@ -1337,6 +1492,20 @@ static int __init dm_cpu_hotplug_init(void)
 		goto err_dm_hotplug_delay;
 	}
 
+	ret = sysfs_create_file(power_kobj, &dm_hotplug_predict.attr);
+	if (ret) {
+		pr_err("%s: failed to create dm_hotplug_predict sysfs interface\n",
+			__func__);
+		goto err_dm_hotplug_predict;
+	}
+
+	ret = sysfs_create_file(power_kobj, &dm_hotplug_fast_cluster_off.attr);
+	if (ret) {
+		pr_err("%s: failed to create dm_hotplug_fast_cluster_off sysfs interface\n",
+			__func__);
+		goto err_dm_hotplug_fast_cluster_off;
+	}
+
 	ret = sysfs_create_file(power_kobj, &cpucore_table.attr);
 	if (ret)
 		goto err;
@@ -1413,6 +1582,10 @@ err_wq:
 err_policy:
 #endif
 #ifdef CONFIG_PM
+	sysfs_remove_file(power_kobj, &dm_hotplug_fast_cluster_off.attr);
+err_dm_hotplug_fast_cluster_off:
+	sysfs_remove_file(power_kobj, &dm_hotplug_predict.attr);
+err_dm_hotplug_predict:
 	sysfs_remove_file(power_kobj, &dm_hotplug_delay.attr);
 err_dm_hotplug_delay:
 	sysfs_remove_file(power_kobj, &dm_hotplug_stay_threshold.attr);
@@ -393,6 +393,124 @@ unsigned int exynos_getspeed(unsigned int cpu)
 	return exynos_getspeed_cluster(cur);
 }
 
+/*
+ * Transition cost telemetry
+ *
+ * cpufreq_stats only knows the time spent at each OPP, not what it cost to
+ * get there. exynos_cpufreq_scale() is timed here as a whole and by phase:
+ * regulator programming (including ABB and the settle time the regulator
+ * driver waits for) and the clock switch itself, which is slower when the
+ * APLL has to be relocked with the core parked on MPLL (see
+ * exynos_get_safe_volt()). Counts and a running average latency are kept
+ * for every (old, new) OPP pair, indexed like freq_table.
+ */
+struct exynos_trans_stats {
+	unsigned int nr;		/* freq_table entries */
+	unsigned int *count;		/* [old * nr + new] */
+	unsigned int *avg_us;		/* [old * nr + new] */
+	u64 total, mpll;		/* transitions, those through MPLL */
+	u64 total_us, volt_us, clk_us, mpll_us;
+	unsigned int max_us;
+	s64 volt_ns;			/* of the transition in progress */
+};
+
+static struct exynos_trans_stats trans_stats[CL_END];
+
+static int exynos_trans_stats_init(cluster_type cluster)
+{
+	struct exynos_trans_stats *ts = &trans_stats[cluster];
+	struct cpufreq_frequency_table *freq_table = exynos_info[cluster]->freq_table;
+	unsigned int nr = 0;
+
+	while (freq_table[nr].frequency != CPUFREQ_TABLE_END)
+		nr++;
+
+	ts->count = kzalloc(nr * nr * sizeof(unsigned int), GFP_KERNEL);
+	ts->avg_us = kzalloc(nr * nr * sizeof(unsigned int), GFP_KERNEL);
+	if (!ts->count || !ts->avg_us) {
+		kfree(ts->count);
+		kfree(ts->avg_us);
+		ts->count = ts->avg_us = NULL;
+		return -ENOMEM;
+	}
+	ts->nr = nr;
+
+	return 0;
+}
+
+/* called with cpufreq_lock held */
+static void exynos_trans_stats_update(cluster_type cluster,
+				unsigned int old_index, unsigned int new_index,
+				s64 total_ns, s64 clk_ns, bool mpll)
+{
+	struct exynos_trans_stats *ts = &trans_stats[cluster];
+	unsigned int us = div_s64(total_ns, NSEC_PER_USEC);
+	unsigned int pair;
+
+	if (!ts->nr)
+		return;
+
+	pair = old_index * ts->nr + new_index;
+	if (!ts->count[pair]++)
+		ts->avg_us[pair] = us;
+	else
+		ts->avg_us[pair] = (ts->avg_us[pair] * 7 + us) / 8;
+
+	ts->total++;
+	ts->total_us += us;
+	ts->volt_us += div_s64(ts->volt_ns, NSEC_PER_USEC);
+	ts->clk_us += div_s64(clk_ns, NSEC_PER_USEC);
+	ts->max_us = max(ts->max_us, us);
+	if (mpll) {
+		ts->mpll++;
+		ts->mpll_us += us;
+	}
+}
+
+static int exynos_freq_to_index(cluster_type cluster, unsigned int freq)
+{
+	struct cpufreq_frequency_table *freq_table = exynos_info[cluster]->freq_table;
+	int i;
+
+	for (i = 0; freq_table[i].frequency != CPUFREQ_TABLE_END; i++)
+		if (freq_table[i].frequency == freq)
+			return i;
+
+	return -EINVAL;
+}
+
+/*
+ * exynos_cpufreq_transition_cost - expected latency of an OPP change in us
+ *
+ * The running average of the (old, new) pair, or the average over all
+ * transitions of the cluster if that pair was not taken yet. Lockless, so
+ * a governor may call it from any context; a torn read only skews one
+ * estimate.
+ */
+unsigned int exynos_cpufreq_transition_cost(struct cpufreq_policy *policy,
+					    unsigned int old_freq,
+					    unsigned int new_freq)
+{
+	cluster_type cur = get_cur_cluster(policy->cpu);
+	struct exynos_trans_stats *ts = &trans_stats[cur];
+	int old_index, new_index;
+	unsigned int pair;
+
+	if (!ts->nr || old_freq == new_freq)
+		return 0;
+
+	old_index = exynos_freq_to_index(cur, old_freq);
+	new_index = exynos_freq_to_index(cur, new_freq);
+	if (old_index >= 0 && new_index >= 0) {
+		pair = old_index * ts->nr + new_index;
+		if (ts->count[pair])
+			return ts->avg_us[pair];
+	}
+
+	return ts->total ? div64_u64(ts->total_us, ts->total) : 0;
+}
+EXPORT_SYMBOL_GPL(exynos_cpufreq_transition_cost);
+
 static unsigned int exynos_get_safe_volt(unsigned int old_index,
 					unsigned int new_index,
 					unsigned int cur)
@@ -461,6 +579,7 @@ static int exynos_set_voltage(unsigned int cur_index,
 	struct regulator *regulator = exynos_info[cluster]->regulator;
 	struct cpufreq_frequency_table *freq_table = exynos_info[cluster]->freq_table;
 	bool set_abb_first_than_volt = false;
+	ktime_t start = ktime_get();
 	int ret = 0;
 
 	if (exynos_info[cluster]->abb_table)
@@ -486,6 +605,7 @@ static int exynos_set_voltage(unsigned int cur_index,
 
 	exynos_info[cluster]->cur_volt = volt;
 out:
+	trans_stats[cluster].volt_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
 	return ret;
 }
 
@@ -498,6 +618,8 @@ static int exynos_cpufreq_scale(unsigned int target_freq,
 	struct cpufreq_policy *policy = cpufreq_cpu_get(cpu);
 	unsigned int new_index, old_index;
 	unsigned int volt, safe_volt = 0;
+	ktime_t start, clk_start;
+	s64 clk_ns;
 	int ret = 0;
 
 	if (!policy) {
@@ -523,6 +645,9 @@ static int exynos_cpufreq_scale(unsigned int target_freq,
 	if (old_index == new_index)
 		goto out;
 
+	start = ktime_get();
+	trans_stats[cur].volt_ns = 0;
+
 	/*
 	 * ARM clock source will be changed APLL to MPLL temporary
 	 * To support this level, need to control regulator for
@@ -581,7 +706,9 @@ static int exynos_cpufreq_scale(unsigned int target_freq,
 #endif
 	}
 
+	clk_start = ktime_get();
 	exynos_info[cur]->set_freq(old_index, new_index);
+	clk_ns = ktime_to_ns(ktime_sub(ktime_get(), clk_start));
 
 	if (old_index < new_index) {
 #if defined(CONFIG_PMU_COREMEM_RATIO)
@@ -634,6 +761,11 @@ static int exynos_cpufreq_scale(unsigned int target_freq,
 		exynos7420_cl_dvfs_start(CLUSTER_ID(cur));
 #endif
 
+	exynos_trans_stats_update(cur, old_index, new_index,
+			ktime_to_ns(ktime_sub(ktime_get(), start)), clk_ns,
+			exynos_info[cur]->need_apll_change &&
+			exynos_info[cur]->need_apll_change(old_index, new_index));
+
 out:
 	cpufreq_cpu_put(policy);
 no_policy:
@@ -842,6 +974,37 @@ out:
 	return ret;
 }
 
+/*
+ * exynos_cpufreq_resolve - the frequency exynos_target() would settle on
+ *
+ * Applies the policy, pm_qos and IPA limits and rounds up to the table
+ * without taking cpufreq_lock or touching the PLL, so it is safe from
+ * scheduler context. Scheduler driven governors use it to drop requests
+ * that would not move the OPP before waking the thread that does the
+ * actual (sleeping) regulator and clock change.
+ */
+unsigned int exynos_cpufreq_resolve(struct cpufreq_policy *policy,
+				    unsigned int target_freq)
+{
+	cluster_type cur = get_cur_cluster(policy->cpu);
+	struct cpufreq_frequency_table *freq_table;
+	unsigned int index;
+
+	if (!exynos_info[cur] || exynos_info[cur]->blocked)
+		return policy->cur;
+
+	freq_table = exynos_info[cur]->freq_table;
+	target_freq = clamp(target_freq, policy->min, policy->max);
+	target_freq = exynos_verify_pm_qos_limit(policy, target_freq, cur);
+
+	if (cpufreq_frequency_table_target(policy, freq_table,
+				target_freq, CPUFREQ_RELATION_L, &index))
+		return policy->cur;
+
+	return freq_table[index].frequency;
+}
+EXPORT_SYMBOL_GPL(exynos_cpufreq_resolve);
+
 static void exynos_qos_nop(void *info)
 {
 }
@@ -1642,24 +1805,105 @@ static ssize_t store_cluster0_volt_table(struct kobject *kobj, struct attribute
 	return store_volt_table(kobj, attr, buf, count, CL_ZERO);
 }
 
+/*
+ * One summary line, then "<old kHz> <new kHz> <count> <avg us>" for every
+ * OPP pair taken so far. Writing anything clears the statistics.
+ */
+static ssize_t show_trans_stats(cluster_type cluster, char *buf)
+{
+	struct exynos_trans_stats *ts = &trans_stats[cluster];
+	struct cpufreq_frequency_table *freq_table = exynos_info[cluster]->freq_table;
+	unsigned int i, j, pair;
+	ssize_t count;
+
+	count = snprintf(buf, PAGE_SIZE,
+			"transitions %llu mpll %llu avg_us %llu max_us %u "
+			"volt_us %llu clk_us %llu mpll_us %llu\n",
+			ts->total, ts->mpll,
+			ts->total ? div64_u64(ts->total_us, ts->total) : 0,
+			ts->max_us, ts->volt_us, ts->clk_us, ts->mpll_us);
+
+	for (i = 0; i < ts->nr; i++) {
+		for (j = 0; j < ts->nr; j++) {
+			pair = i * ts->nr + j;
+			if (!ts->count[pair])
+				continue;
+			if (count >= PAGE_SIZE - 1)
+				return PAGE_SIZE - 1;
+			count += snprintf(&buf[count], PAGE_SIZE - count,
+					"%u %u %u %u\n",
+					freq_table[i].frequency,
+					freq_table[j].frequency,
+					ts->count[pair], ts->avg_us[pair]);
+		}
+	}
+
+	return min_t(ssize_t, count, PAGE_SIZE - 1);
+}
+
+static ssize_t store_trans_stats(cluster_type cluster, size_t count)
+{
+	struct exynos_trans_stats *ts = &trans_stats[cluster];
+
+	mutex_lock(&cpufreq_lock);
+	if (ts->nr) {
+		memset(ts->count, 0, ts->nr * ts->nr * sizeof(unsigned int));
+		memset(ts->avg_us, 0, ts->nr * ts->nr * sizeof(unsigned int));
+	}
+	ts->total = ts->mpll = 0;
+	ts->total_us = ts->volt_us = ts->clk_us = ts->mpll_us = 0;
+	ts->max_us = 0;
+	mutex_unlock(&cpufreq_lock);
+
+	return count;
+}
+
+static ssize_t show_cluster1_trans_stats(struct kobject *kobj,
+			     struct attribute *attr, char *buf)
+{
+	return show_trans_stats(CL_ONE, buf);
+}
+
+static ssize_t store_cluster1_trans_stats(struct kobject *kobj, struct attribute *attr,
+					const char *buf, size_t count)
+{
+	return store_trans_stats(CL_ONE, count);
+}
+
+static ssize_t show_cluster0_trans_stats(struct kobject *kobj,
+			     struct attribute *attr, char *buf)
+{
+	return show_trans_stats(CL_ZERO, buf);
+}
+
+static ssize_t store_cluster0_trans_stats(struct kobject *kobj, struct attribute *attr,
+					const char *buf, size_t count)
+{
+	return store_trans_stats(CL_ZERO, count);
+}
+
 define_one_global_ro(cluster1_freq_table);
 define_one_global_rw(cluster1_min_freq);
 define_one_global_rw(cluster1_max_freq);
 define_one_global_rw(cluster1_volt_table);
+define_one_global_rw(cluster1_trans_stats);
 define_one_global_ro(cluster0_freq_table);
 define_one_global_rw(cluster0_min_freq);
 define_one_global_rw(cluster0_max_freq);
 define_one_global_rw(cluster0_volt_table);
+define_one_global_rw(cluster0_trans_stats);
 
 static struct attribute *mp_attributes[] = {
 	&cluster1_freq_table.attr,
 	&cluster1_min_freq.attr,
 	&cluster1_max_freq.attr,
 	&cluster1_volt_table.attr,
+	&cluster1_trans_stats.attr,
 	&cluster0_freq_table.attr,
 	&cluster0_min_freq.attr,
 	&cluster0_max_freq.attr,
 	&cluster0_volt_table.attr,
+	&cluster0_trans_stats.attr,
 	NULL
 };
 
@@ -2042,6 +2286,10 @@ static int __init exynos_cpufreq_init(void)
 		set_boot_freq(cluster);
 		set_resume_freq(cluster);
 
+		if (exynos_trans_stats_init(cluster))
+			pr_warn("%s: no transition stats for %s\n", __func__,
+					cluster ? "CL_ONE" : "CL_ZERO");
+
 		exynos_info[cluster]->cur_volt = regulator_get_voltage(exynos_info[cluster]->regulator);
 
 		/* set initial old frequency */
@@ -274,7 +274,7 @@ static inline int read_pmu_one(void *data)
 	return 0;
 }
 
-static inline void read_counter_value(struct pmu_count_value *data);
+static inline void read_counter_value(struct pmu_count_value *data)
 {
 	return;
 }
@@ -162,6 +162,7 @@ static int exynos_enter_c2(struct cpuidle_device *dev,
 		flush_tlb_all();
 
 	cpuidle_profile_finish(dev->cpu, ret);
+	cpuidle_history_report(dev->cpu, sub_state & CPD_STATE, ret);
 
 	wakeup_from_c2(dev->cpu);
 
@@ -195,6 +196,7 @@ static int exynos_enter_lpm(struct cpuidle_device *dev,
 	ret = cpu_suspend(index);
 
 	cpuidle_profile_finish(dev->cpu, ret);
+	cpuidle_history_report(dev->cpu, 0, ret);
 
 	exynos_wakeup_sys_powerdown(mode, (bool)ret);
 
@@ -0,0 +1,321 @@
+/*
+ * history.c - the history idle governor
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/cpumask.h>
+#include <linux/pm_qos.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/moduleparam.h>
+#include <linux/module.h>
+
+#define BUCKETS		20	/* log2 us, the last one is >= 256ms */
+#define MIN_SAMPLES	8
+#define MAX_SAMPLES	128
+#define RESOLUTION	1024
+#define DECAY_SHIFT	3
+
+/*
+ * Concepts and ideas behind the history governor
+ *
+ * menu corrects the next timer event with a factor learnt from the past,
+ * which works well when wakeups are timer driven. Most wakeups on a phone
+ * are interrupts though, and what matters for picking a power down state is
+ * not the average idle time but how often it turns out to be too short.
+ *
+ * So every CPU keeps a decaying log2 histogram of its recent idle durations
+ * and the prediction is the duration the CPU stays idle for with a given
+ * confidence (the lower bound of the bucket holding the (100 - confidence)
+ * percentile), capped by the next timer event.
+ *
+ * On top of that every state has an early wakeup rate: the decaying share of
+ * entries that were aborted by the platform or left before the state's
+ * target residency, which is the same thing cpuidle_profiler counts. The
+ * target residency of a state is stretched by up to early_penalty percent
+ * in proportion to that rate, so a state that keeps being left early needs
+ * a longer prediction before it is entered again. A deeper state that would
+ * have paid off for an idle period lowers its rate even if it was not
+ * entered, so a penalty wears off once the workload calms down.
+ *
+ * Cluster power down is not a cpuidle state on Exynos but decided by the
+ * platform code when the last CPU of a cluster enters C2, so the same rate
+ * is kept for it and cpuidle_history_cluster_idle() lets the platform veto
+ * it when any CPU of the cluster is predicted to wake up too soon.
+ */
+
+static unsigned int confidence = 80;
+module_param(confidence, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(confidence, "Percent of idle periods the prediction must hold for");
+
+static unsigned int early_penalty = 300;
+module_param(early_penalty, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(early_penalty, "Target residency stretch in percent at 100% early wakeups");
+
+struct history_device {
+	int		enabled;
+	int		last_state_idx;
+
+	unsigned int	hist[BUCKETS];
+	unsigned int	samples;
+	unsigned int	predicted_us;
+	ktime_t		predicted_end;
+
+	unsigned int	early_rate[CPUIDLE_STATE_MAX];
+
+	/* reported by the platform for the current idle period */
+	int		aborted;
+	int		cluster_down;
+	unsigned int	cluster_residency;
+	unsigned int	cluster_early_rate;
+};
+
+static DEFINE_PER_CPU(struct history_device, history_devices);
+
+static inline int which_bucket(unsigned int duration_us)
+{
+	return min(fls(duration_us), BUCKETS - 1);
+}
+
+static inline unsigned int bucket_floor(int bucket)
+{
+	return bucket ? 1U << (bucket - 1) : 0;
+}
+
+static inline unsigned int penalized(unsigned int residency, unsigned int rate)
+{
+	return residency + (u64)residency * rate * early_penalty /
+			   (RESOLUTION * 100);
+}
+
+static inline void update_rate(unsigned int *rate, int early)
+{
+	if (early)
+		*rate += (RESOLUTION - *rate) >> DECAY_SHIFT;
+	else
+		*rate -= *rate >> DECAY_SHIFT;
+}
+
+static unsigned int history_predict(struct history_device *data)
+{
+	unsigned int limit, sum = 0;
+	int i;
+
+	if (data->samples < MIN_SAMPLES)
+		return UINT_MAX;
+
+	limit = data->samples * (100 - min(confidence, 100U));
+	for (i = 0; i < BUCKETS - 1; i++) {
+		sum += data->hist[i];
+		if (sum * 100 > limit)
+			break;
+	}
+
+	return bucket_floor(i);
+}
+
+static void history_record(struct history_device *data, unsigned int us)
+{
+	int i;
+
+	data->hist[which_bucket(us)]++;
+	if (++data->samples < MAX_SAMPLES)
+		return;
+
+	/* age the histogram so it follows the workload */
+	data->samples = 0;
+	for (i = 0; i < BUCKETS; i++) {
+		data->hist[i] >>= 1;
+		data->samples += data->hist[i];
+	}
+}
+
+/**
+ * history_select - selects the next idle state to enter
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static int history_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct history_device *data = &__get_cpu_var(history_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int sleep_us;
+	int i;
+
+	data->last_state_idx = CPUIDLE_DRIVER_STATE_START;
+	data->aborted = 0;
+	data->cluster_down = 0;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0)) {
+		data->last_state_idx = 0;
+		data->predicted_us = 0;
+		data->predicted_end = ktime_get();
+		return 0;
+	}
+
+	sleep_us = ktime_to_us(tick_nohz_get_sleep_length());
+	data->predicted_us = min(history_predict(data), sleep_us);
+	data->predicted_end = ktime_add_us(ktime_get(), data->predicted_us);
+
+	for (i = CPUIDLE_DRIVER_STATE_START; i < drv->state_count; i++) {
+		struct cpuidle_state *s = &drv->states[i];
+		struct cpuidle_state_usage *su = &dev->states_usage[i];
+
+		if (s->disabled || su->disable)
+			continue;
+		if (s->exit_latency > latency_req)
+			continue;
+		if (penalized(s->target_residency, data->early_rate[i]) >
+		    data->predicted_us)
+			continue;
+
+		data->last_state_idx = i;
+	}
+
+	return data->last_state_idx;
+}
+
+/**
+ * history_reflect - records the actual idle period
+ * @dev: the CPU
+ * @index: the index of actual state entered
+ */
+static void history_reflect(struct cpuidle_device *dev, int index)
+{
+	struct history_device *data = &__get_cpu_var(history_devices);
+	struct cpuidle_driver *drv = cpuidle_get_cpu_driver(dev);
+	unsigned int measured_us = dev->last_residency;
+	int i;
+
+	/* need_resched() or an error before entering, nothing was learnt */
+	if (index < 0 || !drv || !measured_us)
+		return;
+
+	history_record(data, measured_us);
+
+	update_rate(&data->early_rate[index], data->aborted ||
+		    measured_us < drv->states[index].target_residency);
+
+	for (i = index + 1; i < drv->state_count; i++)
+		if (measured_us >= drv->states[i].target_residency)
+			update_rate(&data->early_rate[i], 0);
+
+	if (data->cluster_down)
+		update_rate(&data->cluster_early_rate, data->aborted ||
+			    measured_us < data->cluster_residency);
+	else if (data->cluster_residency &&
+		 measured_us >= data->cluster_residency)
+		update_rate(&data->cluster_early_rate, 0);
+}
+
+/**
+ * cpuidle_history_report - platform feedback about the last idle entry
+ * @cpu: the CPU that left idle
+ * @cluster_down: the cluster was powered down with it
+ * @aborted: the platform did not enter the state (cpu_suspend() failed)
+ */
+void cpuidle_history_report(int cpu, int cluster_down, int aborted)
+{
+	struct history_device *data = &per_cpu(history_devices, cpu);
+
+	data->cluster_down = cluster_down;
+	data->aborted = aborted;
+}
+
+/**
+ * cpuidle_history_cluster_idle - can a cluster be powered down
+ * @mask: the CPUs of the cluster
+ * @residency: target residency of cluster power down in us
+ *
+ * Called by the platform with the last CPU of @mask entering idle. Returns
+ * false if any CPU of the cluster is predicted to wake up before the target
+ * residency, stretched by the early wakeup rate of the calling CPU.
+ */
+bool cpuidle_history_cluster_idle(const struct cpumask *mask,
+				  unsigned int residency)
+{
+	struct history_device *data = &__get_cpu_var(history_devices);
+	ktime_t now = ktime_get();
+	s64 min_us;
+	int cpu;
+
+	if (!data->enabled)
+		return true;
+
+	data->cluster_residency = residency;
+	min_us = penalized(residency, data->cluster_early_rate);
+
+	for_each_cpu_and(cpu, cpu_online_mask, mask) {
+		struct history_device *d = &per_cpu(history_devices, cpu);
+		s64 left_us = ktime_us_delta(d->predicted_end, now);
+
+		/*
+		 * An elapsed prediction means the CPU outstayed it, there is
+		 * no early wakeup expected from it any more.
+		 */
+		if (left_us <= 0)
+			continue;
+		if (left_us < min_us)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * history_enable_device - scans a CPU's states and does setup
+ * @drv: cpuidle driver
+ * @dev: the CPU
+ */
+static int history_enable_device(struct cpuidle_driver *drv,
+				  struct cpuidle_device *dev)
+{
+	struct history_device *data = &per_cpu(history_devices, dev->cpu);
+
+	memset(data, 0, sizeof(struct history_device));
+	data->enabled = 1;
+
+	return 0;
+}
+
+static void history_disable_device(struct cpuidle_driver *drv,
+				   struct cpuidle_device *dev)
+{
+	per_cpu(history_devices, dev->cpu).enabled = 0;
+}
+
+static struct cpuidle_governor history_governor = {
+	.name =		"history",
+	.rating =	30,
+	.enable =	history_enable_device,
+	.disable =	history_disable_device,
+	.select =	history_select,
+	.reflect =	history_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * init_history - initializes the governor
+ */
+static int __init init_history(void)
+{
+	return cpuidle_register_governor(&history_governor);
+}
+
+/**
+ * exit_history - exits the governor
+ */
+static void __exit exit_history(void)
+{
+	cpuidle_unregister_governor(&history_governor);
+}
+
+MODULE_LICENSE("GPL");
+module_init(init_history);
+module_exit(exit_history);
@@ -52,6 +52,7 @@ struct convert_context {
 	unsigned int offset_out;
 	unsigned int idx_in;
 	unsigned int idx_out;
+	unsigned int idx_end;
 	sector_t cc_sector;
 	atomic_t cc_pending;
 	struct ablkcipher_request *req;
@@ -71,12 +72,25 @@ struct dm_crypt_io {
 	int error;
 	sector_t sector;
 	struct dm_crypt_io *base_io;
+
+	/* bvec range of base_bio owned by a parallel fragment, 0 = all */
+	unsigned int frag_idx;
+	unsigned int frag_end;
+	unsigned int frag_size;
 };
 
+/*
+ * With a batching cipher (see crypt_ctr_cipher) one request covers up to
+ * DM_CRYPT_BATCH_SECTORS sectors spread over DM_CRYPT_BATCH_SG segments,
+ * and the cipher derives the IV of every sector from the first one.
+ */
+#define DM_CRYPT_BATCH_SG	8
+#define DM_CRYPT_BATCH_SECTORS	((DM_CRYPT_BATCH_SG * PAGE_SIZE) >> SECTOR_SHIFT)
+
 struct dm_crypt_request {
 	struct convert_context *ctx;
-	struct scatterlist sg_in;
-	struct scatterlist sg_out;
+	struct scatterlist sg_in[DM_CRYPT_BATCH_SG];
+	struct scatterlist sg_out[DM_CRYPT_BATCH_SG];
 	sector_t iv_sector;
 };
 
@@ -113,7 +127,8 @@ struct iv_lmk_private {
  * Crypt: maps a linear range of a block device
  * and encrypts / decrypts at the same time.
  */
-enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID };
+enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
+	     DM_CRYPT_SAME_CPU, DM_CRYPT_INLINE_READ };
 
 /*
  * The fields in here must be read only after initialization.
@@ -133,6 +148,7 @@ struct crypt_config {
 
 	struct workqueue_struct *io_queue;
 	struct workqueue_struct *crypt_queue;
+	struct workqueue_struct *sync_queue;
 
 	char *cipher;
 	char *cipher_string;
@@ -154,6 +170,9 @@ struct crypt_config {
 	struct crypto_ablkcipher **tfms;
 	unsigned tfms_count;
 
+	/* max sectors per crypto request, > 1 only for batching ciphers */
+	unsigned int batch_sectors;
+
 	/*
 	 * Layout of each crypto request:
 	 *
@@ -178,10 +197,23 @@ struct crypt_config {
 #define MIN_IOS        16
 #define MIN_POOL_PAGES 32
 
+/*
+ * Bios larger than split_bytes are cut into fragments that are
+ * encrypted / decrypted in parallel on the unbound crypt workqueue.
+ * Sync reads up to inline_read_bytes are decrypted without going
+ * through the unbound queue when "inline_read" is set.
+ */
+#define DM_CRYPT_SPLIT_BYTES_DEF	(128 * 1024)
+#define DM_CRYPT_INLINE_READ_BYTES_DEF	(16 * 1024)
+
+static unsigned dm_crypt_split_bytes = DM_CRYPT_SPLIT_BYTES_DEF;
+static unsigned dm_crypt_inline_read_bytes = DM_CRYPT_INLINE_READ_BYTES_DEF;
+
 static struct kmem_cache *_crypt_io_pool;
 
 static void clone_init(struct dm_crypt_io *, struct bio *);
 static void kcryptd_queue_crypt(struct dm_crypt_io *io);
+static void kcryptd_queue_read_crypt(struct dm_crypt_io *io);
 static u8 *iv_of_dmreq(struct crypt_config *cc, struct dm_crypt_request *dmreq);
 
 /*
@@ -574,8 +606,8 @@ static int crypt_iv_lmk_gen(struct crypt_config *cc, u8 *iv,
 	int r = 0;
 
 	if (bio_data_dir(dmreq->ctx->bio_in) == WRITE) {
-		src = kmap_atomic(sg_page(&dmreq->sg_in));
-		r = crypt_iv_lmk_one(cc, iv, dmreq, src + dmreq->sg_in.offset);
+		src = kmap_atomic(sg_page(dmreq->sg_in));
+		r = crypt_iv_lmk_one(cc, iv, dmreq, src + dmreq->sg_in->offset);
 		kunmap_atomic(src);
 	} else
 		memset(iv, 0, cc->iv_size);
@@ -592,12 +624,12 @@ static int crypt_iv_lmk_post(struct crypt_config *cc, u8 *iv,
 	if (bio_data_dir(dmreq->ctx->bio_in) == WRITE)
 		return 0;
 
-	dst = kmap_atomic(sg_page(&dmreq->sg_out));
-	r = crypt_iv_lmk_one(cc, iv, dmreq, dst + dmreq->sg_out.offset);
+	dst = kmap_atomic(sg_page(dmreq->sg_out));
+	r = crypt_iv_lmk_one(cc, iv, dmreq, dst + dmreq->sg_out->offset);
 
 	/* Tweak the first block of plaintext sector */
 	if (!r)
-		crypto_xor(dst + dmreq->sg_out.offset, iv, cc->iv_size);
+		crypto_xor(dst + dmreq->sg_out->offset, iv, cc->iv_size);
 
 	kunmap_atomic(dst);
 	return r;
@@ -649,6 +681,7 @@ static void crypt_convert_init(struct crypt_config *cc,
 	ctx->offset_out = 0;
 	ctx->idx_in = bio_in ? bio_in->bi_idx : 0;
 	ctx->idx_out = bio_out ? bio_out->bi_idx : 0;
+	ctx->idx_end = bio_in ? bio_in->bi_vcnt : 0;
 	ctx->cc_sector = sector + cc->iv_offset;
 	init_completion(&ctx->restart);
 }
@@ -676,9 +709,10 @@ static int crypt_convert_block(struct crypt_config *cc,
 			       struct convert_context *ctx,
 			       struct ablkcipher_request *req)
 {
-	struct bio_vec *bv_in = bio_iovec_idx(ctx->bio_in, ctx->idx_in);
-	struct bio_vec *bv_out = bio_iovec_idx(ctx->bio_out, ctx->idx_out);
+	struct bio_vec *bv_in, *bv_out;
 	struct dm_crypt_request *dmreq;
+	unsigned int max_len = cc->batch_sectors << SECTOR_SHIFT;
+	unsigned int len, total = 0, nents = 0;
 	u8 *iv;
 	int r;
 
@@ -687,25 +721,46 @@ static int crypt_convert_block(struct crypt_config *cc,
 
 	dmreq->iv_sector = ctx->cc_sector;
 	dmreq->ctx = ctx;
-	sg_init_table(&dmreq->sg_in, 1);
-	sg_set_page(&dmreq->sg_in, bv_in->bv_page, 1 << SECTOR_SHIFT,
-		    bv_in->bv_offset + ctx->offset_in);
-
-	sg_init_table(&dmreq->sg_out, 1);
-	sg_set_page(&dmreq->sg_out, bv_out->bv_page, 1 << SECTOR_SHIFT,
-		    bv_out->bv_offset + ctx->offset_out);
-
-	ctx->offset_in += 1 << SECTOR_SHIFT;
-	if (ctx->offset_in >= bv_in->bv_len) {
-		ctx->offset_in = 0;
-		ctx->idx_in++;
-	}
+	sg_init_table(dmreq->sg_in, DM_CRYPT_BATCH_SG);
+	sg_init_table(dmreq->sg_out, DM_CRYPT_BATCH_SG);
 
-	ctx->offset_out += 1 << SECTOR_SHIFT;
-	if (ctx->offset_out >= bv_out->bv_len) {
-		ctx->offset_out = 0;
-		ctx->idx_out++;
-	}
+	/*
+	 * Without a batching cipher max_len is one sector and this
+	 * loop runs exactly once.
+	 */
+	do {
+		bv_in = bio_iovec_idx(ctx->bio_in, ctx->idx_in);
+		bv_out = bio_iovec_idx(ctx->bio_out, ctx->idx_out);
+
+		len = min(bv_in->bv_len - ctx->offset_in,
+			  bv_out->bv_len - ctx->offset_out);
+		len = min(len, max_len - total);
+
+		sg_set_page(&dmreq->sg_in[nents], bv_in->bv_page, len,
+			    bv_in->bv_offset + ctx->offset_in);
+		sg_set_page(&dmreq->sg_out[nents], bv_out->bv_page, len,
+			    bv_out->bv_offset + ctx->offset_out);
+		nents++;
+		total += len;
+
+		ctx->offset_in += len;
+		if (ctx->offset_in >= bv_in->bv_len) {
+			ctx->offset_in = 0;
+			ctx->idx_in++;
+		}
+
+		ctx->offset_out += len;
+		if (ctx->offset_out >= bv_out->bv_len) {
+			ctx->offset_out = 0;
+			ctx->idx_out++;
+		}
+	} while (total < max_len && nents < DM_CRYPT_BATCH_SG &&
+		 ctx->idx_in < ctx->idx_end &&
+		 ctx->idx_out < ctx->bio_out->bi_vcnt);
+
+	sg_mark_end(&dmreq->sg_in[nents - 1]);
+	sg_mark_end(&dmreq->sg_out[nents - 1]);
+	ctx->cc_sector += total >> SECTOR_SHIFT;
 
 	if (cc->iv_gen_ops) {
 		r = cc->iv_gen_ops->generator(cc, iv, dmreq);
@@ -713,8 +768,8 @@ static int crypt_convert_block(struct crypt_config *cc,
 			return r;
 	}
 
-	ablkcipher_request_set_crypt(req, &dmreq->sg_in, &dmreq->sg_out,
-				     1 << SECTOR_SHIFT, iv);
+	ablkcipher_request_set_crypt(req, dmreq->sg_in, dmreq->sg_out,
+				     total, iv);
 
 	if (bio_data_dir(ctx->bio_in) == WRITE)
 		r = crypto_ablkcipher_encrypt(req);
@@ -754,7 +809,7 @@ static int crypt_convert(struct crypt_config *cc,
 
 	atomic_set(&ctx->cc_pending, 1);
 
-	while(ctx->idx_in < ctx->bio_in->bi_vcnt &&
+	while(ctx->idx_in < ctx->idx_end &&
 	      ctx->idx_out < ctx->bio_out->bi_vcnt) {
 
 		crypt_alloc_req(cc, ctx);
@@ -771,13 +826,11 @@ static int crypt_convert(struct crypt_config *cc,
 			/* fall through*/
 		case -EINPROGRESS:
 			ctx->req = NULL;
-			ctx->cc_sector++;
 			continue;
 
 		/* sync */
 		case 0:
 			atomic_dec(&ctx->cc_pending);
-			ctx->cc_sector++;
 			cond_resched();
 			continue;
 
@@ -869,6 +922,9 @@ static struct dm_crypt_io *crypt_io_alloc(struct crypt_config *cc,
 	io->sector = sector;
 	io->error = 0;
 	io->base_io = NULL;
+	io->frag_idx = 0;
+	io->frag_end = 0;
+	io->frag_size = 0;
 	io->ctx.req = NULL;
 	atomic_set(&io->io_pending, 0);
 
@@ -946,7 +1002,7 @@ static void crypt_endio(struct bio *clone, int error)
 		bio_put(clone);
 
 		if (rw == READ && !error) {
-			kcryptd_queue_crypt(io);
+			kcryptd_queue_read_crypt(io);
 			return;
 		}
 	}
@@ -1088,7 +1144,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	struct dm_crypt_io *new_io;
 	int crypt_finished;
 	unsigned out_of_pages = 0;
-	unsigned remaining = io->base_bio->bi_size;
+	unsigned remaining = io->frag_end ? io->frag_size : io->base_bio->bi_size;
 	sector_t sector = io->sector;
 	int r;
 
@@ -1097,6 +1153,10 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	 */
 	crypt_inc_pending(io);
 	crypt_convert_init(cc, &io->ctx, NULL, io->base_bio, sector);
+	if (io->frag_end) {
+		io->ctx.idx_in = io->frag_idx;
+		io->ctx.idx_end = io->frag_end;
+	}
 
 	/*
 	 * The allocated buffers can be smaller than the whole bio,
@@ -1156,6 +1216,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 					   io->base_bio, sector);
 			new_io->ctx.idx_in = io->ctx.idx_in;
 			new_io->ctx.offset_in = io->ctx.offset_in;
+			new_io->ctx.idx_end = io->ctx.idx_end;
 
 			/*
 			 * Fragments after the first use the base_io
@@ -1190,6 +1251,10 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 
 	crypt_convert_init(cc, &io->ctx, io->base_bio, io->base_bio,
 			   io->sector);
+	if (io->frag_end) {
+		io->ctx.idx_in = io->ctx.idx_out = io->frag_idx;
+		io->ctx.idx_end = io->frag_end;
+	}
 
 	r = crypt_convert(cc, &io->ctx);
 	if (r < 0)
@@ -1231,14 +1296,85 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 		kcryptd_crypt_write_io_submit(io, 1);
 }
 
+/*
+ * Cut a large bio into fragments on bvec boundaries and hand all but
+ * the first one to the unbound crypt workqueue, so that the crypto of
+ * one big request is spread over the online CPUs instead of being
+ * serialized in a single worker. Every fragment holds a reference on
+ * io (the base_io), which therefore completes the original bio only
+ * after the last fragment has finished.
+ */
+static void kcryptd_crypt_split(struct dm_crypt_io *io)
+{
+	struct crypt_config *cc = io->cc;
+	struct bio *base_bio = io->base_bio;
+	struct dm_crypt_io *new_io;
+	unsigned int chunk, size, idx, start;
+	unsigned int done = 0;
+	int nr_cpus = num_online_cpus();
+
+	if (test_bit(DM_CRYPT_SAME_CPU, &cc->flags) || nr_cpus < 2 ||
+	    !dm_crypt_split_bytes || base_bio->bi_size <= dm_crypt_split_bytes)
+		return;
+
+	chunk = max_t(unsigned int, dm_crypt_split_bytes,
+		      DIV_ROUND_UP(base_bio->bi_size, nr_cpus));
+
+	idx = base_bio->bi_idx;
+	while (idx < base_bio->bi_vcnt) {
+		start = idx;
+		size = 0;
+		do {
+			size += bio_iovec_idx(base_bio, idx)->bv_len;
+			idx++;
+		} while (idx < base_bio->bi_vcnt && size < chunk);
+
+		if (!done) {
+			/* the first fragment stays with io itself */
+			io->frag_idx = start;
+			io->frag_end = idx;
+			io->frag_size = size;
+		} else {
+			new_io = crypt_io_alloc(cc, base_bio,
+					io->sector + (done >> SECTOR_SHIFT));
+			new_io->frag_idx = start;
+			new_io->frag_end = idx;
+			new_io->frag_size = size;
+			new_io->base_io = io;
+			crypt_inc_pending(io);
+
+			/* reads enter conversion with the clone reference held */
+			if (bio_data_dir(base_bio) == READ)
+				crypt_inc_pending(new_io);
+
+			kcryptd_queue_crypt(new_io);
+		}
+		done += size;
+	}
+}
+
 static void kcryptd_crypt(struct work_struct *work)
 {
 	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
+	bool split = !io->base_io && !io->frag_end;
+
+	/*
+	 * A write io holds no reference until kcryptd_crypt_write_convert()
+	 * takes one, so hold one across the split, or a fragment finishing
+	 * first would complete the base bio and free io under us.
+	 */
+	if (split) {
+		crypt_inc_pending(io);
+		kcryptd_crypt_split(io);
+	}
 
 	if (bio_data_dir(io->base_bio) == READ)
 		kcryptd_crypt_read_convert(io);
 	else
 		kcryptd_crypt_write_convert(io);
+
+	if (split)
+		crypt_dec_pending(io);
 }
 
 static void kcryptd_queue_crypt(struct dm_crypt_io *io)
@@ -1249,6 +1385,44 @@ static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 	queue_work(cc->crypt_queue, &io->work);
 }
 
+static void kcryptd_crypt_read_sync(struct work_struct *work)
+{
+	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
+
+	kcryptd_crypt_read_convert(io);
+}
+
+/*
+ * Small synchronous reads are latency bound: with "inline_read" they
+ * are decrypted directly when the clone completes in process context,
+ * or on the bound high priority queue of the completing CPU otherwise,
+ * instead of waiting for an unbound crypt worker to be scheduled.
+ */
+static void kcryptd_queue_read_crypt(struct dm_crypt_io *io)
+{
+	struct crypt_config *cc = io->cc;
+	struct bio *base_bio = io->base_bio;
+
+	if (!test_bit(DM_CRYPT_INLINE_READ, &cc->flags) ||
+	    !(base_bio->bi_rw & REQ_SYNC) ||
+	    base_bio->bi_size > dm_crypt_inline_read_bytes) {
+		kcryptd_queue_crypt(io);
+		return;
+	}
+
+	/*
+	 * crypto requests may sleep, and a clone may complete under a
+	 * spinlock; without CONFIG_PREEMPT_COUNT this always queues
+	 */
+	if (preemptible()) {
+		kcryptd_crypt_read_convert(io);
+		return;
+	}
+
+	INIT_WORK(&io->work, kcryptd_crypt_read_sync);
+	queue_work(cc->sync_queue, &io->work);
+}
+
 /*
  * Decode key from its hex representation
  */
@@ -1413,9 +1587,12 @@ static void crypt_dtr(struct dm_target *ti)
 
 	if (cc->io_queue)
 		destroy_workqueue(cc->io_queue);
-	if (cc->hw_fmp == 0)
+	if (cc->hw_fmp == 0) {
 		if (cc->crypt_queue)
 			destroy_workqueue(cc->crypt_queue);
+		if (cc->sync_queue)
+			destroy_workqueue(cc->sync_queue);
+	}
 
 	crypt_free_tfms(cc);
 
@@ -1542,7 +1719,24 @@ static int crypt_ctr_cipher(struct dm_target *ti,
 	} else {
 		pr_info("%s: S/W disk encryption\n", __func__);
 		/* Allocate cipher */
-		ret = crypt_alloc_tfms(cc, cipher_api);
+		cc->batch_sectors = 1;
+		ret = -ENOENT;
+		if (ivmode && !strcmp(ivmode, "plain64") &&
+		    !strcmp(chainmode, "xts") && cc->tfms_count == 1) {
+			/*
+			 * xts-plain64(cipher) encrypts runs of sectors in one
+			 * request, deriving each sector's IV from the first.
+			 */
+			char batch_api[CRYPTO_MAX_ALG_NAME];
+
+			snprintf(batch_api, sizeof(batch_api),
+				 "xts-plain64(%s)", cipher);
+			ret = crypt_alloc_tfms(cc, batch_api);
+			if (!ret)
+				cc->batch_sectors = DM_CRYPT_BATCH_SECTORS;
+		}
+		if (ret < 0)
+			ret = crypt_alloc_tfms(cc, cipher_api);
 		if (ret < 0) {
 			ti->error = "Error allocating crypto tfm";
 			goto bad;
@@ -1639,7 +1833,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	char tmp[32];
 
 	static struct dm_arg _args[] = {
-		{0, 1, "Invalid number of feature args"},
+		{0, 3, "Invalid number of feature args"},
 	};
 
 	if (argc < 5) {
@@ -1742,15 +1936,25 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		if (ret)
 			goto bad;
 
-		opt_string = dm_shift_arg(&as);
+		while (opt_params--) {
+			opt_string = dm_shift_arg(&as);
+			if (!opt_string) {
+				ret = -EINVAL;
+				ti->error = "Not enough feature arguments";
+				goto bad;
+			}
 
-		if (opt_params == 1 && opt_string &&
-		    !strcasecmp(opt_string, "allow_discards"))
-			ti->num_discard_bios = 1;
-		else if (opt_params) {
-			ret = -EINVAL;
-			ti->error = "Invalid feature arguments";
-			goto bad;
+			if (!strcasecmp(opt_string, "allow_discards"))
+				ti->num_discard_bios = 1;
+			else if (!strcasecmp(opt_string, "same_cpu_crypt"))
+				set_bit(DM_CRYPT_SAME_CPU, &cc->flags);
+			else if (!strcasecmp(opt_string, "inline_read"))
+				set_bit(DM_CRYPT_INLINE_READ, &cc->flags);
+			else {
+				ret = -EINVAL;
+				ti->error = "Invalid feature arguments";
+				goto bad;
+			}
 		}
 	}
 
@@ -1765,15 +1969,33 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	}
 
 	if (cc->hw_fmp == 0) {
-		cc->crypt_queue = alloc_workqueue("kcryptd",
-					  WQ_NON_REENTRANT|
-					  WQ_CPU_INTENSIVE|
-					  WQ_MEM_RECLAIM,
-					  1);
+		if (test_bit(DM_CRYPT_SAME_CPU, &cc->flags))
+			cc->crypt_queue = alloc_workqueue("kcryptd",
+						  WQ_NON_REENTRANT|
+						  WQ_CPU_INTENSIVE|
+						  WQ_MEM_RECLAIM,
+						  1);
+		else
+			cc->crypt_queue = alloc_workqueue("kcryptd",
+						  WQ_UNBOUND|
+						  WQ_MEM_RECLAIM,
+						  num_online_cpus());
 		if (!cc->crypt_queue) {
 			ti->error = "Couldn't create kcryptd queue";
 			goto bad;
 		}
+
+		if (test_bit(DM_CRYPT_INLINE_READ, &cc->flags)) {
+			cc->sync_queue = alloc_workqueue("kcryptd_sync",
+						 WQ_HIGHPRI|
+						 WQ_CPU_INTENSIVE|
+						 WQ_MEM_RECLAIM,
+						 1);
+			if (!cc->sync_queue) {
+				ti->error = "Couldn't create kcryptd sync queue";
+				goto bad;
+			}
+		}
 	}
 
 	ti->num_flush_bios = 1;
@@ -1823,6 +2045,7 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 {
 	struct crypt_config *cc = ti->private;
 	unsigned i, sz = 0;
+	int num_feature_args = 0;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
@@ -1841,8 +2064,18 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		DMEMIT(" %llu %s %llu", (unsigned long long)cc->iv_offset,
 				cc->dev->name, (unsigned long long)cc->start);
 
-		if (ti->num_discard_bios)
-			DMEMIT(" 1 allow_discards");
+		num_feature_args += !!ti->num_discard_bios;
+		num_feature_args += test_bit(DM_CRYPT_SAME_CPU, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_INLINE_READ, &cc->flags);
+		if (num_feature_args) {
+			DMEMIT(" %d", num_feature_args);
+			if (ti->num_discard_bios)
+				DMEMIT(" allow_discards");
+			if (test_bit(DM_CRYPT_SAME_CPU, &cc->flags))
+				DMEMIT(" same_cpu_crypt");
+			if (test_bit(DM_CRYPT_INLINE_READ, &cc->flags))
+				DMEMIT(" inline_read");
+		}
 
 		break;
 	}
@@ -1939,7 +2172,7 @@ static int crypt_iterate_devices(struct dm_target *ti,
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 12, 1},
+	.version = {1, 13, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -1979,6 +2212,12 @@ static void __exit dm_crypt_exit(void)
 module_init(dm_crypt_init);
 module_exit(dm_crypt_exit);
 
+module_param_named(split_bytes, dm_crypt_split_bytes, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(split_bytes, "Bios larger than this are converted on several CPUs (0 = never split)");
+
+module_param_named(inline_read_bytes, dm_crypt_inline_read_bytes, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(inline_read_bytes, "Max sync read size decrypted inline with the inline_read option");
+
 MODULE_AUTHOR("Christophe Saout <christophe@saout.de>");
 MODULE_DESCRIPTION(DM_NAME " target for transparent encryption / decryption");
 MODULE_LICENSE("GPL");
@@ -12,12 +12,18 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * "check_at_most_once" (module parameter default or table feature argument)
+ * keeps a bitmap of data blocks verified since the table was loaded, so that
+ * re-reads of a block are not hashed again. Reads of "verify_split_blocks"
+ * or more blocks are verified in parallel by several kverityd workers.
  */
 
 #include "dm-bufio.h"
 
 #include <linux/module.h>
 #include <linux/device-mapper.h>
+#include <linux/vmalloc.h>
 #include <crypto/hash.h>
 
 #include <linux/ctype.h>
@@ -32,6 +38,7 @@
 #define DM_VERITY_IO_VEC_INLINE		16
 #define DM_VERITY_MEMPOOL_SIZE		4
 #define DM_VERITY_DEFAULT_PREFETCH_SIZE	262144
+#define DM_VERITY_DEFAULT_SPLIT_BLOCKS	32
 
 #define DM_VERITY_MAX_LEVELS		63
 
@@ -41,6 +48,14 @@ static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
 
+static unsigned dm_verity_split_blocks = DM_VERITY_DEFAULT_SPLIT_BLOCKS;
+
+module_param_named(verify_split_blocks, dm_verity_split_blocks, uint, S_IRUGO | S_IWUSR);
+
+static bool dm_verity_check_at_most_once;
+
+module_param_named(check_at_most_once, dm_verity_check_at_most_once, bool, S_IRUGO | S_IWUSR);
+
 struct dm_verity {
 	struct dm_dev *data_dev;
 	struct dm_dev *hash_dev;
@@ -65,9 +80,13 @@ struct dm_verity {
 	int hash_failed;	/* set to 1 if hash of any block failed */
 
 	mempool_t *vec_mempool;	/* mempool of bio vector */
+	mempool_t *frag_mempool;	/* mempool of parallel verify fragments */
 
 	struct workqueue_struct *verify_wq;
 
+	/* bitmap of data blocks verified so far, NULL if not enabled */
+	unsigned long *validated_blocks;
+
 	/* starting blocks for each tree level. 0 is the lowest level. */
 	sector_t hash_level_block[DM_VERITY_MAX_LEVELS];
 };
@@ -86,6 +105,19 @@ struct dm_verity_io {
 	struct bio_vec *io_vec;
 	unsigned io_vec_size;
 
+	/* position of the first block in io_vec */
+	unsigned vector;
+	unsigned offset;
+
+	/*
+	 * A large io is verified by several fragments in parallel. Each
+	 * fragment points to the io of the bio, which counts the pending
+	 * fragments (including itself) and records the first error.
+	 */
+	struct dm_verity_io *parent;
+	atomic_t frags_pending;
+	int frag_error;
+
 	struct work_struct work;
 
 	/* A space for short vectors; longer vectors are allocated separately. */
@@ -331,6 +363,36 @@ static void print_block_data(unsigned long long blocknr, unsigned char *data_to_
 }
 #endif
 
+static bool verity_is_block_validated(struct dm_verity *v, sector_t block)
+{
+	return v->validated_blocks && test_bit(block, v->validated_blocks);
+}
+
+static void verity_set_block_validated(struct dm_verity *v, sector_t block)
+{
+	if (v->validated_blocks)
+		set_bit(block, v->validated_blocks);
+}
+
+/*
+ * Advance (*vector, *offset) in the saved bio vector by "bytes".
+ */
+static void verity_advance_vec(struct dm_verity_io *io, unsigned bytes,
+			       unsigned *vector, unsigned *offset)
+{
+	while (bytes) {
+		struct bio_vec *bv = &io->io_vec[*vector];
+		unsigned len = min(bv->bv_len - *offset, bytes);
+
+		*offset += len;
+		if (*offset == bv->bv_len) {
+			*offset = 0;
+			(*vector)++;
+		}
+		bytes -= len;
+	}
+}
+
 /*
  * Verify one "dm_verity_io" structure.
  */
@@ -339,7 +401,7 @@ static int verity_verify_io(struct dm_verity_io *io)
 	struct dm_verity *v = io->v;
 	unsigned b;
 	int i;
-	unsigned vector = 0, offset = 0;
+	unsigned vector = io->vector, offset = io->offset;
 
 	for (b = 0; b < io->n_blocks; b++) {
 		struct shash_desc *desc;
@@ -347,6 +409,12 @@ static int verity_verify_io(struct dm_verity_io *io)
 		int r;
 		unsigned todo;
 
+		if (verity_is_block_validated(v, io->block + b)) {
+			verity_advance_vec(io, 1 << v->data_dev_block_bits,
+					   &vector, &offset);
+			continue;
+		}
+
 		if (likely(v->levels)) {
 			/*
 			 * First, we try to get the requested hash for
@@ -449,10 +517,13 @@ test_block_hash:
 #endif
 				return -EIO;
 			}
-		}
+		} else
+			verity_set_block_validated(v, io->block + b);
+	}
+	if (!io->parent) {
+		BUG_ON(vector != io->io_vec_size);
+		BUG_ON(offset);
 	}
-	BUG_ON(vector != io->io_vec_size);
-	BUG_ON(offset);
 
 	return 0;
 }
@@ -474,11 +545,103 @@ static void verity_finish_io(struct dm_verity_io *io, int error)
 	bio_endio(bio, error);
 }
 
+/*
+ * One fragment (or the unsplit io itself) is done. The bio is ended
+ * when the last fragment of its io finishes.
+ */
+static void verity_fragment_done(struct dm_verity_io *io, int error)
+{
+	struct dm_verity *v = io->v;
+	struct dm_verity_io *parent = io->parent ? io->parent : io;
+
+	if (unlikely(error))
+		cmpxchg(&parent->frag_error, 0, error);
+
+	if (io != parent)
+		mempool_free(io, v->frag_mempool);
+
+	if (atomic_dec_and_test(&parent->frags_pending))
+		verity_finish_io(parent, parent->frag_error);
+}
+
+static void verity_fragment_work(struct work_struct *w)
+{
+	struct dm_verity_io *io = container_of(w, struct dm_verity_io, work);
+
+	verity_fragment_done(io, verity_verify_io(io));
+}
+
+/*
+ * Hand the tail of a large io to other kverityd workers in chunks so that
+ * the blocks of one bio are hashed on several CPUs. Fragments are carved
+ * off from the end and the io keeps whatever remains at the front, so if
+ * a fragment can't be allocated the io simply verifies more blocks itself.
+ * Fragments share io_vec with the io, which stays valid until the last
+ * fragment is done.
+ */
+static void verity_split_io(struct dm_verity_io *io)
+{
+	struct dm_verity *v = io->v;
+	struct dm_verity_io *frag;
+	unsigned nr_cpus = num_online_cpus();
+	unsigned split = ACCESS_ONCE(dm_verity_split_blocks);
+	unsigned chunk, start, k;
+
+	if (nr_cpus < 2 || !split || io->n_blocks < split)
+		return;
+
+	chunk = max(split, DIV_ROUND_UP(io->n_blocks, nr_cpus));
+
+	io->parent = io;
+	for (k = DIV_ROUND_UP(io->n_blocks, chunk) - 1; k > 0; k--) {
+		frag = mempool_alloc(v->frag_mempool, GFP_NOWAIT);
+		if (!frag)
+			break;
+
+		start = k * chunk;
+		frag->v = v;
+		frag->block = io->block + start;
+		frag->n_blocks = io->n_blocks - start;
+		frag->io_vec = io->io_vec;
+		frag->io_vec_size = io->io_vec_size;
+		frag->vector = io->vector;
+		frag->offset = io->offset;
+		verity_advance_vec(io, start << v->data_dev_block_bits,
+				   &frag->vector, &frag->offset);
+		frag->parent = io;
+		io->n_blocks = start;
+
+		atomic_inc(&io->frags_pending);
+		INIT_WORK(&frag->work, verity_fragment_work);
+		queue_work(v->verify_wq, &frag->work);
+	}
+}
+
 static void verity_work(struct work_struct *w)
 {
 	struct dm_verity_io *io = container_of(w, struct dm_verity_io, work);
 
-	verity_finish_io(io, verity_verify_io(io));
+	atomic_set(&io->frags_pending, 1);
+	io->frag_error = 0;
+
+	verity_split_io(io);
+
+	verity_fragment_done(io, verity_verify_io(io));
+}
+
+static bool verity_io_validated(struct dm_verity_io *io)
+{
+	struct dm_verity *v = io->v;
+	unsigned b;
+
+	if (!v->validated_blocks)
+		return false;
+
+	for (b = 0; b < io->n_blocks; b++)
+		if (!test_bit(io->block + b, v->validated_blocks))
+			return false;
+
+	return true;
 }
 
 static void verity_end_io(struct bio *bio, int error)
@@ -490,6 +653,12 @@ static void verity_end_io(struct bio *bio, int error)
 		return;
 	}
 
+	/* every block was verified before, complete without a worker */
+	if (verity_io_validated(io)) {
+		verity_finish_io(io, 0);
+		return;
+	}
+
 	INIT_WORK(&io->work, verity_work);
 	queue_work(io->v->verify_wq, &io->work);
 }
@@ -584,6 +753,9 @@ static int verity_map(struct dm_target *ti, struct bio *bio)
 	io->orig_bi_private = bio->bi_private;
 	io->block = bio->bi_sector >> (v->data_dev_block_bits - SECTOR_SHIFT);
 	io->n_blocks = bio->bi_size >> v->data_dev_block_bits;
+	io->vector = 0;
+	io->offset = 0;
+	io->parent = NULL;
 
 	bio->bi_end_io = verity_end_io;
 	bio->bi_private = io;
@@ -635,6 +807,8 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 		else
 			for (x = 0; x < v->salt_size; x++)
 				DMEMIT("%02x", v->salt[x]);
+		if (v->validated_blocks)
+			DMEMIT(" 1 check_at_most_once");
 		break;
 	}
 }
@@ -696,9 +870,14 @@ static void verity_dtr(struct dm_target *ti)
 	if (v->verify_wq)
 		destroy_workqueue(v->verify_wq);
 
+	if (v->frag_mempool)
+		mempool_destroy(v->frag_mempool);
+
 	if (v->vec_mempool)
 		mempool_destroy(v->vec_mempool);
 
+	vfree(v->validated_blocks);
+
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
@@ -732,6 +911,8 @@ static void verity_dtr(struct dm_target *ti)
  *	<algorithm>
  *	<digest>
  *	<salt>		Hex string or "-" if no salt.
+ *	[<#opt_params> <opt_params>]
+ *			check_at_most_once: verify each data block only once.
  */
 static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 {
@@ -742,6 +923,7 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	int i;
 	sector_t hash_position;
 	char dummy;
+	bool check_at_most_once = dm_verity_check_at_most_once;
 
 	v = kzalloc(sizeof(struct dm_verity), GFP_KERNEL);
 	if (!v) {
@@ -757,12 +939,40 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
-	if (argc != 10) {
-		ti->error = "Invalid argument count: exactly 10 arguments required";
+	if (argc < 10) {
+		ti->error = "Invalid argument count: at least 10 arguments required";
 		r = -EINVAL;
 		goto bad;
 	}
 
+	/* Optional parameters */
+	if (argc > 10) {
+		struct dm_arg_set as;
+		unsigned opt_params;
+		const char *opt_string;
+		static struct dm_arg _args[] = {
+			{0, 1, "Invalid number of feature args"},
+		};
+
+		as.argc = argc - 10;
+		as.argv = argv + 10;
+
+		r = dm_read_arg_group(_args, &as, &opt_params, &ti->error);
+		if (r)
+			goto bad;
+
+		while (opt_params--) {
+			opt_string = dm_shift_arg(&as);
+			if (opt_string && !strcasecmp(opt_string, "check_at_most_once"))
+				check_at_most_once = true;
+			else {
+				ti->error = "Invalid feature arguments";
+				r = -EINVAL;
+				goto bad;
+			}
+		}
+	}
+
 	if (sscanf(argv[0], "%d%c", &num, &dummy) != 1 ||
 	    num > 1) {
 		ti->error = "Invalid version";
@@ -936,6 +1146,24 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
+	v->frag_mempool = mempool_create_kmalloc_pool(DM_VERITY_MEMPOOL_SIZE,
+					ti->per_bio_data_size);
+	if (!v->frag_mempool) {
+		ti->error = "Cannot allocate fragment mempool";
+		r = -ENOMEM;
+		goto bad;
+	}
+
+	if (check_at_most_once) {
+		v->validated_blocks = vzalloc(BITS_TO_LONGS(v->data_blocks) *
+					      sizeof(unsigned long));
+		if (!v->validated_blocks) {
+			ti->error = "Cannot allocate validated blocks bitmap";
+			r = -ENOMEM;
+			goto bad;
+		}
+	}
+
 	/* WQ_UNBOUND greatly improves performance when running on ramdisk */
 	v->verify_wq = alloc_workqueue("kverityd", WQ_CPU_INTENSIVE | WQ_MEM_RECLAIM | WQ_UNBOUND, num_online_cpus());
 	if (!v->verify_wq) {
@@ -954,7 +1182,7 @@ bad:
 
 static struct target_type verity_target = {
 	.name		= "verity",
-	.version	= {1, 2, 0},
+	.version	= {1, 3, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
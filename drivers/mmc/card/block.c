@@ -131,6 +131,14 @@ enum {
 module_param(perdev_minors, int, 0444);
 MODULE_PARM_DESC(perdev_minors, "Minors numbers to allocate per device");
 
+/*
+ * Packing saves the per command overhead of small random writes; large
+ * writes gain nothing from it and would only delay the reads behind them.
+ */
+static unsigned int packed_max_sectors = 128;
+module_param(packed_max_sectors, uint, 0644);
+MODULE_PARM_DESC(packed_max_sectors, "Largest write packed with others (0 = any)");
+
 static inline int mmc_blk_part_switch(struct mmc_card *card,
 				      struct mmc_blk_data *md);
 static int get_card_status(struct mmc_card *card, u32 *status, int retries);
@@ -1579,6 +1587,9 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	    !IS_ALIGNED(blk_rq_sectors(cur), 8))
 		goto no_packed;
 
+	if (packed_max_sectors && blk_rq_sectors(cur) > packed_max_sectors)
+		goto no_packed;
+
 	mmc_blk_clear_packed(mqrq);
 
 	max_blk_count = min(card->host->max_blk_count,
@@ -1620,6 +1631,10 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 		if (rq_data_dir(cur) != rq_data_dir(next))
 			break;
 
+		if (packed_max_sectors &&
+		    blk_rq_sectors(next) > packed_max_sectors)
+			break;
+
 		if (mmc_req_rel_wr(next) &&
 		    (md->flags & MMC_BLK_REL_WR) && !en_rel_wr)
 			break;
@@ -1876,10 +1891,12 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 				goto cmd_abort;
 			}
 
-			if (reqs >= packed_nr)
+			if (reqs >= packed_nr) {
 				mmc_blk_packed_hdr_wrq_prep(mq->mqrq_cur,
 							    card, mq);
-			else
+				card->host->queue_stats.packed_cmds++;
+				card->host->queue_stats.packed_reqs += reqs;
+			} else
 				mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
 			areq = &mq->mqrq_cur->mmc_active;
 			if (card->ext_csd.cmdq_mode_en)
@@ -256,6 +256,30 @@ static struct mmc_request *mmc_get_dat_que(struct mmc_host *host)
 	return mrq;
 }
 
+static void mmc_queue_stats_issue(struct mmc_host *host,
+				  struct mmc_async_req *areq)
+{
+	int depth = atomic_read(&host->areq_cnt) - 1;
+
+	areq->issue_time = ktime_get();
+	host->queue_stats.depth[clamp(depth, 0, EMMC_MAX_QUEUE_DEPTH)]++;
+}
+
+static void mmc_queue_stats_done(struct mmc_host *host,
+				 struct mmc_request *mrq)
+{
+	struct mmc_queue_stats *st = &host->queue_stats;
+	int dir = mrq->cmd->opcode == MMC_WRITE_REQUESTED_QUEUE ? WRITE : READ;
+	u64 us = ktime_us_delta(ktime_get(), mrq->areq->issue_time);
+	int idx = us ? min_t(int, ilog2(us), MMC_QUEUE_LAT_BUCKETS - 1) : 0;
+
+	st->lat[dir][idx]++;
+	st->nr[dir]++;
+	st->total_us[dir] += us;
+	if (us > st->max_us[dir])
+		st->max_us[dir] = us;
+}
+
 static void mmc_post_req(struct mmc_host *host, struct mmc_request *mrq,
 			 int err);
 static void mmc_run_queue(struct mmc_host *host, int from)
@@ -282,10 +306,17 @@ static void mmc_run_queue(struct mmc_host *host, int from)
 	if (from == 0)
 		return;
 
-	/* completion for previous request */
+	/*
+	 * Completion for previous request. It is deferred to overlap with
+	 * the next data transfer, but only when one is actually queued:
+	 * otherwise the task would stay accounted in areq_cnt until the
+	 * card reports another task ready, and the queue thread could not
+	 * refill the freed slot meanwhile.
+	 */
 	spin_lock_irqsave(&host->que_lock, flags);
 	if (((host->state) & MMC_CMDQ_DAT) ||
-	    (atomic_read(&host->areq_cnt) <= 1)) {
+	    (atomic_read(&host->areq_cnt) <= 1) ||
+	    list_empty(&host->dat_que)) {
 		mrq = host->done_mrq;
 		host->done_mrq = NULL;
 	} else
@@ -298,6 +329,7 @@ static void mmc_run_queue(struct mmc_host *host, int from)
 
 		cmd = mrq->cmd;
 		err = mrq->areq->err_check(host->card, mrq->areq);
+		mmc_queue_stats_done(host, mrq);
 		mmc_post_req(host, mrq, 0);
 		mmc_blk_end_queued_req(host, mrq->areq, cmd->arg >> 16, err);
 
@@ -864,9 +896,10 @@ struct mmc_async_req *mmc_start_req(struct mmc_host *host,
 		trace_mmc_blk_rw_start(areq->mrq->cmd->opcode,
 				       areq->mrq->cmd->arg,
 				       areq->mrq->data);
-		if (host->card->ext_csd.cmdq_mode_en)
+		if (host->card->ext_csd.cmdq_mode_en) {
+			mmc_queue_stats_issue(host, areq);
 			start_err = __mmc_start_data_req(host, areq->mrq_que);
-		else
+		} else
 			start_err = __mmc_start_data_req(host, areq->mrq);
 	}
 
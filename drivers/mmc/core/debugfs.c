@@ -202,6 +202,61 @@ static int mmc_clock_opt_set(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(mmc_clock_fops, mmc_clock_opt_get, mmc_clock_opt_set,
 	"%llu\n");
 
+static int mmc_queue_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_host *host = s->private;
+	struct mmc_queue_stats *st = &host->queue_stats;
+	static const char *dir_str[] = { "read", "write" };
+	int dir, i;
+
+	seq_printf(s, "queue depth at issue:\n");
+	for (i = 0; i <= EMMC_MAX_QUEUE_DEPTH; i++)
+		if (st->depth[i])
+			seq_printf(s, "  %2d:\t%lu\n", i, st->depth[i]);
+
+	for (dir = 0; dir < 2; dir++) {
+		seq_printf(s, "%s tasks:\t%lu avg %llu us max %llu us\n",
+			dir_str[dir], st->nr[dir],
+			st->nr[dir] ? div64_u64(st->total_us[dir], st->nr[dir]) : 0,
+			st->max_us[dir]);
+		for (i = 0; i < MMC_QUEUE_LAT_BUCKETS; i++)
+			if (st->lat[dir][i])
+				seq_printf(s, "  %s%6lu us:\t%lu\n",
+					i == MMC_QUEUE_LAT_BUCKETS - 1 ? ">=" : "< ",
+					i == MMC_QUEUE_LAT_BUCKETS - 1 ?
+					1UL << i : 2UL << i, st->lat[dir][i]);
+	}
+
+	seq_printf(s, "packed writes:\t%lu (%lu requests)\n",
+		st->packed_cmds, st->packed_reqs);
+
+	return 0;
+}
+
+static int mmc_queue_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_queue_stats_show, inode->i_private);
+}
+
+static ssize_t mmc_queue_stats_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct mmc_host *host = ((struct seq_file *)file->private_data)->private;
+
+	/* any write clears the statistics */
+	memset(&host->queue_stats, 0, sizeof(host->queue_stats));
+
+	return count;
+}
+
+static const struct file_operations mmc_queue_stats_fops = {
+	.open		= mmc_queue_stats_open,
+	.read		= seq_read,
+	.write		= mmc_queue_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void mmc_add_host_debugfs(struct mmc_host *host)
 {
 	struct dentry *root;
@@ -224,6 +279,10 @@ void mmc_add_host_debugfs(struct mmc_host *host)
 			&mmc_clock_fops))
 		goto err_node;
 
+	if (!debugfs_create_file("queue_stats", S_IRUSR | S_IWUSR, root, host,
+			&mmc_queue_stats_fops))
+		goto err_node;
+
 #ifdef CONFIG_MMC_CLKGATE
 	if (!debugfs_create_u32("clk_delay", (S_IRUSR | S_IWUSR),
 				root, &host->clk_delay))
@@ -40,6 +40,9 @@
 #include <linux/async.h>
 #include <linux/devfreq.h>
 #include <linux/nls.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/topology.h>
 #if defined(CONFIG_UFS_FMP_DM_CRYPT)
 #include <linux/smc.h>
 #endif
@@ -82,6 +85,11 @@
 
 /* Interrupt aggregation default timeout, unit: 40us */
 #define INT_AGGR_DEF_TO	0x01
+/* Queue depth below which commands bypass aggregation */
+#define INT_AGGR_IMMEDIATE_QD	1
+
+/* Requests per completion steering decision, see ufshcd_cmpl_steer_account() */
+#define UFS_STEER_WINDOW	64
 
 /* Link Hibernation delay, msecs */
 #define LINK_H8_DELAY  10
@@ -559,6 +567,104 @@ ufshcd_config_intr_aggr(struct ufs_hba *hba, u8 cnt, u8 tmout)
 		      REG_UTP_TRANSFER_REQ_INT_AGG_CONTROL);
 }
 
+/**
+ * ufshcd_intr_aggr_bypass - Check if a command should skip aggregation
+ * @hba: per adapter instance
+ *
+ * At low queue depth aggregation only delays the completion by its timeout,
+ * so such commands are flagged to interrupt on completion. This works on
+ * every host, including those with UFSHCI_QUIRK_SKIP_INTR_AGGR whose
+ * aggregation registers are left at the values programmed in
+ * ufshcd_make_hba_operational(). The lockless read of outstanding_reqs is
+ * fine for this heuristic.
+ */
+static inline bool ufshcd_intr_aggr_bypass(struct ufs_hba *hba)
+{
+	struct ufs_intr_aggr *ia = &hba->intr_aggr;
+
+	return ia->bypass &&
+		hweight_long(ACCESS_ONCE(hba->outstanding_reqs)) <
+		ia->immediate_qd;
+}
+
+/**
+ * ufshcd_intr_aggr_account - Account a transfer completion interrupt
+ * @hba: per adapter instance
+ * @nr_cmpl: number of requests completed by this interrupt
+ *
+ * Called with host_lock held.
+ */
+static inline void ufshcd_intr_aggr_account(struct ufs_hba *hba, int nr_cmpl)
+{
+	if (!nr_cmpl)
+		return;
+
+	hba->intr_aggr.nr_intr++;
+	hba->intr_aggr.nr_cmpl += nr_cmpl;
+}
+
+/**
+ * ufshcd_cmpl_steer_account - Account the cluster a request comes from
+ * @hba: per adapter instance
+ * @rq: request being issued
+ *
+ * The block layer already runs the completion softirq on the submitting
+ * cluster (rq_affinity), but the interrupt itself, which touches the
+ * doorbell, the LRBs and the response UPIUs, stays on the CPU it was
+ * routed to at boot. Every UFS_STEER_WINDOW requests, if at least three
+ * quarters of them were submitted from a single cluster other than the
+ * one the interrupt is on, the interrupt is moved there. Called with
+ * host_lock held.
+ */
+static void ufshcd_cmpl_steer_account(struct ufs_hba *hba, struct request *rq)
+{
+	struct ufs_cmpl_steer *cs = &hba->cmpl_steer;
+	int cpu = rq->cpu != -1 ? rq->cpu : smp_processor_id();
+	int cluster = topology_physical_package_id(cpu);
+	int i, best = 0;
+
+	if (!cs->enable || cluster < 0 || cluster >= UFS_STEER_MAX_CLUSTERS)
+		return;
+
+	cs->nr_sub[cluster]++;
+	if (++cs->window < UFS_STEER_WINDOW)
+		return;
+
+	for (i = 1; i < UFS_STEER_MAX_CLUSTERS; i++)
+		if (cs->nr_sub[i] > cs->nr_sub[best])
+			best = i;
+
+	/* the current request votes for the majority most of the time */
+	if (best == cluster && best != cs->cluster &&
+	    cs->nr_sub[best] * 4 >= cs->window * 3) {
+		cs->target_cpu = cpu;
+		schedule_work(&cs->work);
+	}
+
+	memset(cs->nr_sub, 0, sizeof(cs->nr_sub));
+	cs->window = 0;
+}
+
+static void ufshcd_cmpl_steer_work(struct work_struct *work)
+{
+	struct ufs_hba *hba = container_of(work, struct ufs_hba,
+			cmpl_steer.work);
+	struct ufs_cmpl_steer *cs = &hba->cmpl_steer;
+	int cpu = ACCESS_ONCE(cs->target_cpu);
+	unsigned long flags;
+
+	if (!cpu_online(cpu))
+		return;
+
+	if (irq_set_affinity(hba->irq, topology_core_cpumask(cpu)))
+		return;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	cs->cluster = topology_physical_package_id(cpu);
+	cs->nr_moves++;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+}
+
 /**
  * ufshcd_enable_run_stop_reg - Enable run-stop registers,
  *			When run-stop registers are set to 1, it indicates the
@@ -593,10 +699,79 @@ static inline int ufshcd_is_hba_active(struct ufs_hba *hba)
 	return (ufshcd_readl(hba, REG_CONTROLLER_ENABLE) & 0x1) ? 0 : 1;
 }
 
+/*
+ * Gating delay prediction. Idle periods are measured from the release that
+ * arms gate_work to the next ufshcd_hold(). When they are typically shorter
+ * than UFSHCD_IDLE_SHORT_DELAYS gating delays, most gatings would be
+ * undone right away by a request that pays the hibern8 exit and ungate
+ * latency, so gating is postponed to UFSHCD_GATE_LATE_DELAYS delays. When
+ * they are longer than UFSHCD_IDLE_LONG_DELAYS delays the host gates after
+ * a quarter of the delay to save power.
+ */
+#define UFSHCD_IDLE_SHORT_DELAYS	2
+#define UFSHCD_IDLE_LONG_DELAYS		8
+#define UFSHCD_GATE_LATE_DELAYS		4
+#define UFSHCD_IDLE_MAX_US		(1000 * USEC_PER_MSEC)
+
+/* host lock must be held */
+static void ufshcd_clk_gating_idle_end(struct ufs_hba *hba)
+{
+	struct ufs_clk_gating *gating = &hba->clk_gating;
+	u64 idle_us;
+
+	if (!gating->idle_start.tv64)
+		return;
+
+	idle_us = ktime_us_delta(ktime_get(), gating->idle_start);
+	gating->idle_start.tv64 = 0;
+	idle_us = min_t(u64, idle_us, UFSHCD_IDLE_MAX_US);
+	if (gating->idle_avg_us)
+		gating->idle_avg_us = (gating->idle_avg_us * 3 + idle_us) >> 2;
+	else
+		gating->idle_avg_us = idle_us;
+}
+
+/* host lock must be held */
+static unsigned long ufshcd_clk_gating_delay(struct ufs_hba *hba)
+{
+	struct ufs_clk_gating *gating = &hba->clk_gating;
+	u64 delay_us = (u64)gating->delay_ms * USEC_PER_MSEC;
+
+	gating->idle_start = ktime_get();
+
+	if (!gating->predict || !gating->idle_avg_us || !delay_us)
+		return gating->delay_ms;
+
+	if (gating->idle_avg_us < delay_us * UFSHCD_IDLE_SHORT_DELAYS) {
+		gating->nr_gate_late++;
+		return gating->delay_ms * UFSHCD_GATE_LATE_DELAYS;
+	}
+
+	if (gating->idle_avg_us > delay_us * UFSHCD_IDLE_LONG_DELAYS) {
+		gating->nr_gate_early++;
+		return max(gating->delay_ms / 4, 1UL);
+	}
+
+	return gating->delay_ms;
+}
+
+static void ufshcd_lat_hist_add(struct ufs_lat_hist *hist, ktime_t start)
+{
+	u64 us = ktime_us_delta(ktime_get(), start);
+	int idx = us ? min_t(int, ilog2(us), UFS_LAT_HIST_BUCKETS - 1) : 0;
+
+	hist->bucket[idx]++;
+	hist->nr++;
+	hist->total_us += us;
+	if (us > hist->max_us)
+		hist->max_us = us;
+}
+
 static void ufshcd_ungate_work(struct work_struct *work)
 {
 	int ret;
 	unsigned long flags;
+	ktime_t start;
 	struct ufs_hba *hba = container_of(work, struct ufs_hba,
 			clk_gating.ungate_work);
 	bool gating_allowed = !ufshcd_can_fake_clkgating(hba);
@@ -624,6 +799,7 @@ static void ufshcd_ungate_work(struct work_struct *work)
 		hba->clk_gating.is_suspended = true;
 		if (ufshcd_is_link_hibern8(hba)) {
 			ufshcd_set_link_trans_active(hba);
+			start = ktime_get();
 			ret = ufshcd_link_hibern8_ctrl(hba, false);
 			if (ret) {
 				ufshcd_set_link_off(hba);
@@ -631,6 +807,8 @@ static void ufshcd_ungate_work(struct work_struct *work)
 					__func__, ret);
 			} else {
 				ufshcd_set_link_active(hba);
+				ufshcd_lat_hist_add(&hba->clk_gating.h8_exit_lat,
+						start);
 			}
 		}
 		hba->clk_gating.is_suspended = false;
@@ -638,6 +816,14 @@ static void ufshcd_ungate_work(struct work_struct *work)
 unblock_reqs:
 	if (ufshcd_is_clkscaling_enabled(hba))
 		devfreq_resume_device(hba->devfreq);
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	start = hba->clk_gating.ungate_start;
+	hba->clk_gating.ungate_start.tv64 = 0;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+	if (start.tv64)
+		ufshcd_lat_hist_add(&hba->clk_gating.ungate_lat, start);
+
 	scsi_unblock_requests(hba->host);
 }
 
@@ -656,6 +842,7 @@ int ufshcd_hold(struct ufs_hba *hba, bool async)
 		goto out;
 	spin_lock_irqsave(hba->host->host_lock, flags);
 	hba->clk_gating.active_reqs++;
+	ufshcd_clk_gating_idle_end(hba);
 
 start:
 	switch (hba->clk_gating.state) {
@@ -678,6 +865,7 @@ start:
 	case CLKS_OFF:
 		scsi_block_requests(hba->host);
 		hba->clk_gating.state = REQ_CLKS_ON;
+		hba->clk_gating.ungate_start = ktime_get();
 		queue_work(hba->ufshcd_workq, &hba->clk_gating.ungate_work);
 		/*
 		 * fall through to check if we should wait for this
@@ -796,7 +984,7 @@ static void __ufshcd_release(struct ufs_hba *hba)
 
 	hba->clk_gating.state = REQ_CLKS_OFF;
 	queue_delayed_work(hba->ufshcd_workq, &hba->clk_gating.gate_work,
-			msecs_to_jiffies(hba->clk_gating.delay_ms));
+			msecs_to_jiffies(ufshcd_clk_gating_delay(hba)));
 }
 
 void ufshcd_release(struct ufs_hba *hba)
@@ -870,6 +1058,110 @@ static ssize_t ufshcd_clkgate_delay_store(struct device *dev,
 	return count;
 }
 
+static ssize_t ufshcd_clkgate_predict_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", hba->clk_gating.predict);
+}
+
+static ssize_t ufshcd_clkgate_predict_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	unsigned long flags, value;
+
+	if (kstrtoul(buf, 0, &value))
+		return -EINVAL;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	hba->clk_gating.predict = !!value;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+	return count;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static void ufshcd_lat_hist_show(struct seq_file *s, const char *name,
+		struct ufs_lat_hist *hist)
+{
+	int i;
+
+	seq_printf(s, "%s: nr %lu avg_us %llu max_us %llu\n", name, hist->nr,
+		   hist->nr ? div64_u64(hist->total_us, hist->nr) : 0,
+		   hist->max_us);
+	for (i = 0; i < UFS_LAT_HIST_BUCKETS; i++)
+		seq_printf(s, "  %s%6lu us: %lu\n",
+			   i == UFS_LAT_HIST_BUCKETS - 1 ? ">=" : "< ",
+			   i == UFS_LAT_HIST_BUCKETS - 1 ? 1UL << i : 2UL << i,
+			   hist->bucket[i]);
+}
+
+static int ufshcd_clkgate_lat_show(struct seq_file *s, void *data)
+{
+	struct ufs_hba *hba = s->private;
+	struct ufs_clk_gating *gating = &hba->clk_gating;
+
+	seq_printf(s, "idle_avg_us %llu gate_early %lu gate_late %lu\n",
+		   gating->idle_avg_us, gating->nr_gate_early,
+		   gating->nr_gate_late);
+	ufshcd_lat_hist_show(s, "ungate", &gating->ungate_lat);
+	ufshcd_lat_hist_show(s, "hibern8_exit", &gating->h8_exit_lat);
+	return 0;
+}
+
+static int ufshcd_clkgate_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ufshcd_clkgate_lat_show, inode->i_private);
+}
+
+static ssize_t ufshcd_clkgate_lat_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct ufs_hba *hba = ((struct seq_file *)file->private_data)->private;
+	unsigned long flags;
+
+	/* any write clears the histograms */
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	memset(&hba->clk_gating.ungate_lat, 0, sizeof(struct ufs_lat_hist));
+	memset(&hba->clk_gating.h8_exit_lat, 0, sizeof(struct ufs_lat_hist));
+	hba->clk_gating.nr_gate_early = 0;
+	hba->clk_gating.nr_gate_late = 0;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+	return count;
+}
+
+static const struct file_operations ufshcd_clkgate_lat_fops = {
+	.open		= ufshcd_clkgate_lat_open,
+	.read		= seq_read,
+	.write		= ufshcd_clkgate_lat_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void ufshcd_clkgate_debugfs_init(struct ufs_hba *hba)
+{
+	hba->clk_gating.debugfs_root = debugfs_create_dir(dev_name(hba->dev),
+							  NULL);
+	if (IS_ERR_OR_NULL(hba->clk_gating.debugfs_root)) {
+		hba->clk_gating.debugfs_root = NULL;
+		return;
+	}
+	debugfs_create_file("clkgate_latency", S_IRUSR | S_IWUSR,
+			    hba->clk_gating.debugfs_root, hba,
+			    &ufshcd_clkgate_lat_fops);
+}
+
+static void ufshcd_clkgate_debugfs_exit(struct ufs_hba *hba)
+{
+	debugfs_remove_recursive(hba->clk_gating.debugfs_root);
+	hba->clk_gating.debugfs_root = NULL;
+}
+#else
+static inline void ufshcd_clkgate_debugfs_init(struct ufs_hba *hba) {}
+static inline void ufshcd_clkgate_debugfs_exit(struct ufs_hba *hba) {}
+#endif
+
 static int ufshcd_init_clk_gating(struct ufs_hba *hba)
 {
 	int ret = 0;
@@ -895,6 +1187,17 @@ static int ufshcd_init_clk_gating(struct ufs_hba *hba)
 	if (device_create_file(hba->dev, &hba->clk_gating.delay_attr))
 		dev_err(hba->dev, "Failed to create sysfs for clkgate_delay\n");
 
+	hba->clk_gating.predict = true;
+	hba->clk_gating.predict_attr.show = ufshcd_clkgate_predict_show;
+	hba->clk_gating.predict_attr.store = ufshcd_clkgate_predict_store;
+	sysfs_attr_init(&hba->clk_gating.predict_attr.attr);
+	hba->clk_gating.predict_attr.attr.name = "clkgate_predict";
+	hba->clk_gating.predict_attr.attr.mode = S_IRUGO | S_IWUSR;
+	if (device_create_file(hba->dev, &hba->clk_gating.predict_attr))
+		dev_err(hba->dev, "Failed to create sysfs for clkgate_predict\n");
+
+	ufshcd_clkgate_debugfs_init(hba);
+
 out:
 	return ret;
 }
@@ -905,6 +1208,8 @@ static void ufshcd_exit_clk_gating(struct ufs_hba *hba)
 		return;
 	destroy_workqueue(hba->ufshcd_workq);
 	device_remove_file(hba->dev, &hba->clk_gating.delay_attr);
+	device_remove_file(hba->dev, &hba->clk_gating.predict_attr);
+	ufshcd_clkgate_debugfs_exit(hba);
 }
 
 
@@ -1579,25 +1884,27 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 
 	tag = cmd->request->tag;
 
-	spin_lock_irqsave(hba->host->host_lock, flags);
-	switch (hba->ufshcd_state) {
+	/*
+	 * The state is sampled without host_lock on the fast path and
+	 * checked again under the lock right before the doorbell is rung.
+	 */
+	switch (ACCESS_ONCE(hba->ufshcd_state)) {
 	case UFSHCD_STATE_OPERATIONAL:
 		break;
 	case UFSHCD_STATE_RESET:
 		err = SCSI_MLQUEUE_HOST_BUSY;
-		goto out_unlock;
+		goto out;
 	case UFSHCD_STATE_ERROR:
 		set_host_byte(cmd, DID_ERROR);
 		cmd->scsi_done(cmd);
-		goto out_unlock;
+		goto out;
 	default:
 		dev_WARN_ONCE(hba->dev, 1, "%s: invalid state %d\n",
 				__func__, hba->ufshcd_state);
 		set_host_byte(cmd, DID_BAD_TARGET);
 		cmd->scsi_done(cmd);
-		goto out_unlock;
+		goto out;
 	}
-	spin_unlock_irqrestore(hba->host->host_lock, flags);
 
 	/* acquire the tag to make sure device cmds don't use it */
 	if (test_and_set_bit_lock(tag, &hba->lrb_in_use)) {
@@ -1627,7 +1934,7 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 	lrbp->sense_buffer = cmd->sense_buffer;
 	lrbp->task_tag = tag;
 	lrbp->lun = ufshcd_scsi_to_upiu_lun(cmd->device->lun);
-	lrbp->intr_cmd = false;
+	lrbp->intr_cmd = ufshcd_intr_aggr_bypass(hba);
 	lrbp->command_type = UTP_CMD_TYPE_SCSI;
 
 	/* form UPIU before issuing the command */
@@ -1653,10 +1960,23 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 
 	/* issue command to the controller */
 	spin_lock_irqsave(hba->host->host_lock, flags);
+	if (unlikely(hba->ufshcd_state != UFSHCD_STATE_OPERATIONAL)) {
+		/* raced with error handling, let the midlayer retry */
+		spin_unlock_irqrestore(hba->host->host_lock, flags);
+#if defined(CONFIG_UFS_FMP_ECRYPT_FS)
+		fmp_clear_sg(lrbp);
+#endif
+		scsi_dma_unmap(cmd);
+		lrbp->cmd = NULL;
+		clear_bit_unlock(tag, &hba->lrb_in_use);
+		ufshcd_release(hba);
+		err = SCSI_MLQUEUE_HOST_BUSY;
+		goto out;
+	}
 	if (hba->vops && hba->vops->set_nexus_t_xfer_req)
 		hba->vops->set_nexus_t_xfer_req(hba, tag, lrbp->cmd);
+	ufshcd_cmpl_steer_account(hba, cmd->request);
 	ufshcd_send_command(hba, tag);
-out_unlock:
 	spin_unlock_irqrestore(hba->host->host_lock, flags);
 out:
 	return err;
@@ -3418,6 +3738,20 @@ static int ufshcd_slave_configure(struct scsi_device *sdev)
 	blk_queue_max_segment_size(q, PRDT_DATA_BYTE_COUNT_MAX);
 	blk_queue_update_dma_alignment(q, PAGE_SIZE - 1);
 
+	/*
+	 * All LUNs share the host's tag space and doorbell, so let one
+	 * CPU at a time feed the queue instead of every submitter
+	 * contending on the queue lock in scsi_request_fn().
+	 */
+	queue_flag_set_unlocked(QUEUE_FLAG_SINGLE_DISPATCH, q);
+
+	/*
+	 * Complete requests on the submitting cluster; the completion
+	 * interrupt follows the submitters too, see
+	 * ufshcd_cmpl_steer_account().
+	 */
+	queue_flag_set_unlocked(QUEUE_FLAG_SAME_COMP, q);
+
 	return 0;
 }
 
@@ -3642,6 +3976,8 @@ static void __ufshcd_transfer_req_compl(struct ufs_hba *hba, int reason)
 #if defined(CONFIG_UFS_FMP_ECRYPT_FS)
 			fmp_clear_sg(lrbp);
 #endif
+			if (lrbp->intr_cmd)
+				hba->intr_aggr.nr_immediate++;
 			result = ufshcd_transfer_rsp_status(hba, lrbp);
 			scsi_dma_unmap(cmd);
 			cmd->result = result;
@@ -3662,6 +3998,9 @@ static void __ufshcd_transfer_req_compl(struct ufs_hba *hba, int reason)
 	/* clear corresponding bits of completed commands */
 	hba->outstanding_reqs ^= completed_reqs;
 
+	if (!reason)
+		ufshcd_intr_aggr_account(hba, hweight_long(completed_reqs));
+
 	if (!tr_doorbell) {
 		hba->tcx_replay_timer_expired_cnt = 0;
 		hba->fcx_protection_timer_expired_cnt = 0;
@@ -6206,6 +6545,7 @@ void ufshcd_remove(struct ufs_hba *hba)
 	/* disable interrupts */
 	ufshcd_disable_intr(hba, hba->intr_mask);
 	ufshcd_hba_stop(hba);
+	cancel_work_sync(&hba->cmpl_steer.work);
 
 	scsi_host_put(hba->host);
 
@@ -6259,6 +6599,117 @@ static ssize_t ufshcd_manufacturer_id_show(struct device *dev,
 	return curr_len;
 }
 
+static ssize_t ufshcd_intr_aggr_bypass_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct Scsi_Host *host = container_of(dev, struct Scsi_Host, shost_dev);
+	struct ufs_hba *hba = shost_priv(host);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", hba->intr_aggr.bypass);
+}
+
+static ssize_t ufshcd_intr_aggr_bypass_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct Scsi_Host *host = container_of(dev, struct Scsi_Host, shost_dev);
+	struct ufs_hba *hba = shost_priv(host);
+	unsigned long flags, value;
+
+	if (kstrtoul(buf, 0, &value))
+		return -EINVAL;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	hba->intr_aggr.bypass = !!value;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return count;
+}
+
+static ssize_t ufshcd_intr_aggr_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct Scsi_Host *host = container_of(dev, struct Scsi_Host, shost_dev);
+	struct ufs_hba *hba = shost_priv(host);
+	struct ufs_intr_aggr *ia = &hba->intr_aggr;
+	u64 per_intr;
+
+	per_intr = ia->nr_intr ? div64_u64(ia->nr_cmpl * 100, ia->nr_intr) : 0;
+
+	return snprintf(buf, PAGE_SIZE,
+			"interrupts %llu\ncompleted %llu\nimmediate %llu\n"
+			"completed_per_interrupt %llu.%02llu\n",
+			ia->nr_intr, ia->nr_cmpl, ia->nr_immediate,
+			div_u64(per_intr, 100), per_intr % 100);
+}
+
+static void ufshcd_add_intr_aggr_sysfs_nodes(struct ufs_hba *hba)
+{
+	struct device *dev = &(hba->host->shost_dev);
+	struct ufs_intr_aggr *ia = &hba->intr_aggr;
+
+	ia->bypass_attr.show = ufshcd_intr_aggr_bypass_show;
+	ia->bypass_attr.store = ufshcd_intr_aggr_bypass_store;
+	sysfs_attr_init(&ia->bypass_attr.attr);
+	ia->bypass_attr.attr.name = "intr_aggr_bypass";
+	ia->bypass_attr.attr.mode = S_IRUGO | S_IWUSR;
+	if (device_create_file(dev, &ia->bypass_attr))
+		dev_err(hba->dev, "Failed to create sysfs for intr_aggr_bypass\n");
+
+	ia->stats_attr.show = ufshcd_intr_aggr_stats_show;
+	ia->stats_attr.store = NULL;
+	sysfs_attr_init(&ia->stats_attr.attr);
+	ia->stats_attr.attr.name = "intr_aggr_stats";
+	ia->stats_attr.attr.mode = S_IRUGO;
+	if (device_create_file(dev, &ia->stats_attr))
+		dev_err(hba->dev, "Failed to create sysfs for intr_aggr_stats\n");
+}
+
+static ssize_t ufshcd_cmpl_steer_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct Scsi_Host *host = container_of(dev, struct Scsi_Host, shost_dev);
+	struct ufs_hba *hba = shost_priv(host);
+	struct ufs_cmpl_steer *cs = &hba->cmpl_steer;
+
+	return snprintf(buf, PAGE_SIZE, "%d\ncluster %d\nmoves %lu\n",
+			cs->enable, cs->cluster, cs->nr_moves);
+}
+
+static ssize_t ufshcd_cmpl_steer_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct Scsi_Host *host = container_of(dev, struct Scsi_Host, shost_dev);
+	struct ufs_hba *hba = shost_priv(host);
+	struct ufs_cmpl_steer *cs = &hba->cmpl_steer;
+	unsigned long flags, value;
+
+	if (kstrtoul(buf, 0, &value))
+		return -EINVAL;
+
+	/* disabling leaves the interrupt where it is */
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	cs->enable = !!value;
+	memset(cs->nr_sub, 0, sizeof(cs->nr_sub));
+	cs->window = 0;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return count;
+}
+
+static void ufshcd_add_cmpl_steer_sysfs_nodes(struct ufs_hba *hba)
+{
+	struct device *dev = &(hba->host->shost_dev);
+	struct ufs_cmpl_steer *cs = &hba->cmpl_steer;
+
+	cs->enable_attr.show = ufshcd_cmpl_steer_show;
+	cs->enable_attr.store = ufshcd_cmpl_steer_store;
+	sysfs_attr_init(&cs->enable_attr.attr);
+	cs->enable_attr.attr.name = "cmpl_steer";
+	cs->enable_attr.attr.mode = S_IRUGO | S_IWUSR;
+	if (device_create_file(dev, &cs->enable_attr))
+		dev_err(hba->dev, "Failed to create sysfs for cmpl_steer\n");
+}
+
 static void ufshcd_add_manufacturer_id_sysfs_nodes(struct ufs_hba *hba)
 {
 	struct device *dev = &(hba->host->shost_dev);
@@ -6395,6 +6846,8 @@ static inline void ufshcd_add_sysfs_nodes(struct ufs_hba *hba)
 	ufshcd_add_bkops_en_sysfs_nodes(hba);
 	ufshcd_add_caps_sysfs_node(hba);
 	ufshcd_add_manufacturer_id_sysfs_nodes(hba);
+	ufshcd_add_intr_aggr_sysfs_nodes(hba);
+	ufshcd_add_cmpl_steer_sysfs_nodes(hba);
 }
 
 /**
@@ -6619,6 +7072,13 @@ int ufshcd_init(struct ufs_hba *hba, void __iomem *mmio_base, unsigned int irq)
 	/* Initialize device management tag acquire wait queue */
 	init_waitqueue_head(&hba->dev_cmd.tag_wq);
 
+	hba->intr_aggr.bypass = true;
+	hba->intr_aggr.immediate_qd = INT_AGGR_IMMEDIATE_QD;
+
+	hba->cmpl_steer.enable = true;
+	hba->cmpl_steer.cluster = -1;
+	INIT_WORK(&hba->cmpl_steer.work, ufshcd_cmpl_steer_work);
+
 	err = ufshcd_init_clk_gating(hba);
 	if (err) {
 		dev_err(hba->dev, "init clk_gating failed\n");
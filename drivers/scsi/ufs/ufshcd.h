@@ -310,6 +310,23 @@ enum clk_gating_state {
 	__CLKS_ON,
 };
 
+#define UFS_LAT_HIST_BUCKETS	16
+
+/**
+ * struct ufs_lat_hist - log2 latency histogram
+ * @bucket: bucket n counts latencies in [2^n, 2^(n+1)) us, the first and
+ * the last bucket also take what falls below or above
+ * @nr: number of samples
+ * @total_us: sum of the samples
+ * @max_us: largest sample
+ */
+struct ufs_lat_hist {
+	unsigned long bucket[UFS_LAT_HIST_BUCKETS];
+	unsigned long nr;
+	u64 total_us;
+	u64 max_us;
+};
+
 /**
  * struct ufs_clk_gating - UFS clock gating related info
  * @gate_work: worker to turn off clocks after some delay as specified in
@@ -323,6 +340,17 @@ enum clk_gating_state {
  * @delay_attr: sysfs attribute to control delay_attr
  * @active_reqs: number of requests that are pending and should be waited for
  * completion before gating clocks.
+ * @predict: choose the gating delay from the predicted idle period instead
+ * of always using delay_ms
+ * @idle_start: time the host last became idle, zero while busy
+ * @idle_avg_us: running average of the recent idle periods
+ * @ungate_start: time a request found the clocks gated
+ * @nr_gate_early: idle periods gated after a shortened delay
+ * @nr_gate_late: idle periods where gating was postponed
+ * @predict_attr: sysfs attribute to control @predict
+ * @ungate_lat: latency charged to requests for ungating the clocks
+ * @h8_exit_lat: hibern8 exit latency, part of @ungate_lat
+ * @debugfs_root: debugfs directory of the latency histograms
  */
 struct ufs_clk_gating {
 	struct delayed_work gate_work;
@@ -332,6 +360,61 @@ struct ufs_clk_gating {
 	bool is_suspended;
 	struct device_attribute delay_attr;
 	int active_reqs;
+	bool predict;
+	ktime_t idle_start;
+	u64 idle_avg_us;
+	ktime_t ungate_start;
+	unsigned long nr_gate_early;
+	unsigned long nr_gate_late;
+	struct device_attribute predict_attr;
+	struct ufs_lat_hist ungate_lat;
+	struct ufs_lat_hist h8_exit_lat;
+	struct dentry *debugfs_root;
+};
+
+/**
+ * struct ufs_intr_aggr - transfer completion interrupt aggregation bypass
+ * @bypass: let commands issued at low queue depth skip aggregation
+ * @immediate_qd: commands issued while fewer requests than this are
+ * outstanding interrupt on completion, bypassing aggregation
+ * @nr_intr: transfer completion interrupts that completed requests
+ * @nr_cmpl: completed requests
+ * @nr_immediate: completed requests that bypassed aggregation
+ * @bypass_attr: sysfs attribute to control @bypass
+ * @stats_attr: sysfs attribute to read the counters
+ */
+struct ufs_intr_aggr {
+	bool bypass;
+	unsigned int immediate_qd;
+	u64 nr_intr;
+	u64 nr_cmpl;
+	u64 nr_immediate;
+	struct device_attribute bypass_attr;
+	struct device_attribute stats_attr;
+};
+
+#define UFS_STEER_MAX_CLUSTERS	4
+
+/**
+ * struct ufs_cmpl_steer - steer the completion interrupt to the submitters
+ * @enable: move the interrupt to the cluster issuing most of the requests
+ * @nr_sub: requests issued from each cluster in the current window
+ * @window: requests accounted in the current window
+ * @cluster: cluster the interrupt was last moved to, -1 if never moved
+ * @target_cpu: a CPU of the cluster the interrupt has to be moved to
+ * @nr_moves: number of times the interrupt was moved
+ * @work: moves the interrupt, irq affinity can't be changed under host_lock
+ * @enable_attr: sysfs attribute to control @enable
+ */
+struct ufs_cmpl_steer {
+	bool enable;
+	unsigned int nr_sub[UFS_STEER_MAX_CLUSTERS];
+	unsigned int window;
+	int cluster;
+	int target_cpu;
+	unsigned long nr_moves;
+	struct work_struct work;
+	struct device_attribute enable_attr;
 };
 
 struct ufs_clk_scaling {
@@ -507,6 +590,8 @@ struct ufs_hba {
 
 	struct devfreq *devfreq;
 	struct ufs_clk_scaling clk_scaling;
+	struct ufs_intr_aggr intr_aggr;
+	struct ufs_cmpl_steer cmpl_steer;
 	bool is_sys_suspended;
 
 	u32 quirks;
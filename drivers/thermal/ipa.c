@@ -93,6 +93,9 @@ struct ipa_config {
 	int hotplug_in_threshold;
 	u32 cores_out;
 	u32 enable_ctlr;
+	u32 enable_pred;
+	u32 period_ms;
+	u32 horizon_ms;
 	struct ctlr ctlr;
 };
 
@@ -115,6 +118,9 @@ static struct ipa_config default_config = {
 	.enable_ctlr = 1,
 	.hotplug_out_threshold = 10,
 	.hotplug_in_threshold = 2,
+	.enable_pred = 1,
+	.period_ms = 50,
+	.horizon_ms = 5000,
 	.ctlr = {
 		.mult = 2,
 		.k_i = 1,
@@ -138,8 +144,42 @@ unsigned int get_power_value(struct cpu_power_info *power_info);
 int get_ipa_dvfs_max_freq(void);
 int get_real_max_freq(cluster_type cluster);
 
+/* period the controller gains were tuned for */
 #define ARBITER_PERIOD_MSEC 100
 
+/*
+ * Thermal predictor
+ *
+ * The skin warms up slowly, so by the time the PID controller sees the
+ * temperature cross the setpoint the heat of the last seconds is already
+ * on its way and the controller has to cut deep to catch up, which is what
+ * makes sustained workloads (gaming, camera recording) saw-tooth.
+ *
+ * The predictor keeps the last PRED_WINDOW samples of skin temperature and
+ * total power and learns a first order model of the device:
+ *
+ *	dT/period = gain * (P - p_eq)
+ *
+ * p_eq, the power at which the temperature holds, is learnt while the
+ * temperature is flat and gain while it moves. The controller then acts on
+ * the temperature forecast horizon_ms ahead, and the power that brings the
+ * forecast to control_temp replaces the static tdp as feed forward. The
+ * gain is per poll, so it relearns after period_ms is changed.
+ */
+#define PRED_WINDOW	32
+#define PRED_GAIN_SHIFT	20
+#define PRED_MIN_DP	200	/* mW, smaller deltas say nothing about gain */
+
+struct ipa_predictor {
+	int temp[PRED_WINDOW];	/* decidegrees */
+	int power[PRED_WINDOW];	/* mW */
+	int power_sum;
+	int idx, nr;
+	int p_eq;		/* mW */
+	s64 gain;		/* decidegrees per period per mW << PRED_GAIN_SHIFT */
+	int forecast;		/* decidegrees */
+};
+
 static int nr_big_coeffs, nr_little_coeffs;
 
 static struct arbiter_data
@@ -163,6 +203,8 @@ static struct arbiter_data
 
 	int gpu_freq_limit, cpu_freq_limits[NUM_CLUSTERS];
 
+	struct ipa_predictor pred;
+
 	struct delayed_work work;
 } arbiter_data = {
 	.initialised = false,
@@ -204,6 +246,87 @@ static void reset_controller(struct ctlr *ctlr_config)
 	ctlr_config->err_integral = ctlr_config->integral_reset_value;
 }
 
+/* the history is stale after a pause, the learnt model is not */
+static void reset_predictor(struct ipa_predictor *pred)
+{
+	pred->idx = 0;
+	pred->nr = 0;
+	pred->power_sum = 0;
+	pred->forecast = 0;
+}
+
+static int pred_horizon(struct ipa_config *config)
+{
+	return config->horizon_ms / max(config->period_ms, 1U);
+}
+
+static void predictor_update(struct ipa_predictor *pred, int temp, int power)
+{
+	int dT, p_avg;
+	s64 gain;
+
+	if (pred->nr < PRED_WINDOW) {
+		pred->nr++;
+		goto store;
+	}
+
+	/* the slot about to be replaced is the oldest sample */
+	dT = temp - pred->temp[pred->idx];
+	p_avg = pred->power_sum / PRED_WINDOW;
+	pred->power_sum -= pred->power[pred->idx];
+
+	if (abs(dT) <= 1) {
+		if (!pred->p_eq)
+			pred->p_eq = p_avg;
+		else
+			pred->p_eq += (p_avg - pred->p_eq) / 8;
+	} else if (pred->p_eq && abs(p_avg - pred->p_eq) >= PRED_MIN_DP) {
+		gain = div_s64((s64)dT << PRED_GAIN_SHIFT,
+			       (p_avg - pred->p_eq) * PRED_WINDOW);
+		/* heating below p_eq is a p_eq that is off, not a gain */
+		if (gain > 0) {
+			if (!pred->gain)
+				pred->gain = gain;
+			else
+				pred->gain += div_s64(gain - pred->gain, 8);
+		}
+	}
+
+store:
+	pred->temp[pred->idx] = temp;
+	pred->power[pred->idx] = power;
+	pred->power_sum += power;
+	pred->idx = (pred->idx + 1) % PRED_WINDOW;
+}
+
+static int predictor_forecast(struct ipa_predictor *pred, int temp, int power,
+			      int horizon)
+{
+	if (!pred->gain)
+		return temp;
+
+	return temp + ((pred->gain * (power - pred->p_eq) * horizon) >>
+		       PRED_GAIN_SHIFT);
+}
+
+/*
+ * Power (mW) that brings the temperature to @target over the horizon, or
+ * the static tdp while the model is not trained yet.
+ */
+static int predictor_budget(struct ipa_predictor *pred, struct ipa_config *config,
+			    int temp, int target, int horizon)
+{
+	s64 budget;
+
+	if (!pred->gain || !horizon)
+		return config->tdp;
+
+	budget = pred->p_eq + div64_s64((s64)(target - temp) << PRED_GAIN_SHIFT,
+					pred->gain * horizon);
+
+	return clamp_t(s64, budget, 0, config->soc_max_power);
+}
+
 static void init_controller_coeffs(struct ipa_config *config)
 {
 	config->ctlr.k_po = int_to_frac(config->tdp) / config->temp_threshold;
@@ -230,7 +353,7 @@ static int queue_arbiter_poll(void)
 	cpu = cpumask_any(arbiter_data.cl_stats[CL_ZERO].mask);
 	ret = queue_delayed_work_on(cpu, system_freezable_wq,
 				&arbiter_data.work,
-				msecs_to_jiffies(ARBITER_PERIOD_MSEC));
+				msecs_to_jiffies(max(arbiter_data.config.period_ms, 10U)));
 
 	arbiter_data.active = true;
 
@@ -533,6 +656,7 @@ void check_switch_ipa_on(int max_temp)
 		/* Switch On */
 		/* Reset the controller before re-starting */
 		reset_controller(&arbiter_data.config.ctlr);
+		reset_predictor(&arbiter_data.pred);
 		queue_arbiter_poll();
 	}
 
@@ -573,7 +697,7 @@ static int F(int deltaT)
 	return limits[deltaT+3];
 }
 
-static int F_ctlr(int curr)
+static int F_ctlr(int curr, int feed_forward)
 {
 	struct ipa_config *config = &arbiter_data.config;
 	int setpoint = config->control_temp;
@@ -597,11 +721,13 @@ static int F_ctlr(int curr)
 		i = mul_frac(ctlr->k_i, ctlr->err_integral);
 
 		if (err_int < config->ctlr.integral_cutoff) {
-			s64 tmpi = mul_frac(ctlr->k_i, err);
+			/* integrate over time, not over polls */
+			int err_dt = err * (int)config->period_ms / ARBITER_PERIOD_MSEC;
+			s64 tmpi = mul_frac(ctlr->k_i, err_dt);
 			tmpi += i;
 			if (tmpi <= int_to_frac(config->soc_max_power)) {
 				i = tmpi;
-				ctlr->err_integral += err;
+				ctlr->err_integral += err_dt;
 			}
 		}
 	}
@@ -616,14 +742,15 @@ static int F_ctlr(int curr)
 	 * error (which is driving closer to the line) results in less
 	 * power being applied (slowing down the controller
 	 */
-	d = mul_frac(ctlr->k_d, err - ctlr->err_prev);
+	d = mul_frac(ctlr->k_d, err - ctlr->err_prev) * ARBITER_PERIOD_MSEC /
+		max(config->period_ms, 1U);
 	ctlr->err_prev = err;
 
 	out = p + i + d;
 	out = frac_to_int(out);
 
 	if (ctlr->feed_forward)
-		out += config->tdp;
+		out += feed_forward;
 
 	/* output power must not be negative */
 	if (out < 0)
@@ -741,6 +868,7 @@ static int debugfs_s32_set(void *data, u64 val)
 
 DEFINE_SIMPLE_ATTRIBUTE(power_fops, debugfs_u32_get, debugfs_power_set, "%llu\n");
 DEFINE_SIMPLE_ATTRIBUTE(signed_fops, debugfs_s32_get, debugfs_s32_set, "%lld\n");
+DEFINE_SIMPLE_ATTRIBUTE(signed_fops_ro, debugfs_s32_get, NULL, "%lld\n");
 
 /* Shamelessly ripped from fs/debugfs/file.c */
 static ssize_t read_file_bool(struct file *file, char __user *user_buf,
@@ -920,6 +1048,40 @@ static const struct file_operations enabled_fops = {
 	.llseek = default_llseek,
 };
 
+static void setup_debugfs_pred(struct ipa_config *config, struct dentry *parent)
+{
+	struct ipa_predictor *pred = &arbiter_data.pred;
+	struct dentry *pred_d, *dentry_f;
+
+	pred_d = debugfs_create_dir("pred", parent);
+	if (IS_ERR_OR_NULL(pred_d))
+		pr_warn("unable to create debugfs directory: pred\n");
+
+	dentry_f = debugfs_create_bool("enabled", 0644, pred_d,
+				       &config->enable_pred);
+	if (!dentry_f)
+		pr_warn("unable to create debugfs file: enabled\n");
+
+	dentry_f = debugfs_create_u32("horizon_ms", 0644, pred_d,
+				      &config->horizon_ms);
+	if (!dentry_f)
+		pr_warn("unable to create debugfs file: horizon_ms\n");
+
+	dentry_f = debugfs_create_file("p_eq", 0444, pred_d, &pred->p_eq,
+				       &signed_fops_ro);
+	if (!dentry_f)
+		pr_warn("unable to create debugfs file: p_eq\n");
+
+	dentry_f = debugfs_create_u64("gain", 0444, pred_d, (u64 *)&pred->gain);
+	if (!dentry_f)
+		pr_warn("unable to create debugfs file: gain\n");
+
+	dentry_f = debugfs_create_file("forecast", 0444, pred_d,
+				       &pred->forecast, &signed_fops_ro);
+	if (!dentry_f)
+		pr_warn("unable to create debugfs file: forecast\n");
+}
+
 static struct dentry *setup_debugfs(struct ipa_config *config)
 {
 	struct dentry *ipa_d, *dentry_f;
@@ -1002,7 +1164,13 @@ static struct dentry *setup_debugfs(struct ipa_config *config)
 	if (!dentry_f)
 		pr_warn("unable to create debugfs file: enable_ctlr\n");
 
+	dentry_f = debugfs_create_u32("period_ms", 0644, ipa_d,
+				      &config->period_ms);
+	if (!dentry_f)
+		pr_warn("unable to create debugfs file: period_ms\n");
+
 	setup_debugfs_ctlr(config, ipa_d);
+	setup_debugfs_pred(config, ipa_d);
 	return ipa_d;
 }
 
@@ -1171,6 +1339,68 @@ static int get_cpu_power_req(int cl_idx, struct coefficients *coeffs, int nr_coe
 	return power;
 }
 
+#define PPW_MIN_WEIGHT	(1 << (WEIGHT_SHIFT - 1))
+#define PPW_MAX_WEIGHT	(2 << WEIGHT_SHIFT)
+
+/*
+ * Throughput of a cluster over the last window in capacity units (MHz x
+ * arch_efficiency, the scale of the scheduler's efficiency table).
+ * inv_util is the summed frequency invariant utilisation of the cluster's
+ * CPUs, a percentage of the cluster's own max frequency, so it has to be
+ * scaled by the capacity there to compare clusters.
+ */
+static u64 cluster_perf(int cl_idx)
+{
+	if (!c_eff)
+		return 0;
+
+	return (u64)max(arbiter_data.cl_stats[cl_idx].inv_util, 0) *
+	       KHZ_TO_MHZ(get_real_max_freq(cl_idx)) *
+	       c_eff[cl_idx].arch_efficiency;
+}
+
+/*
+ * Scale the CPU power requests by how much throughput a watt buys on each
+ * cluster, measured over the last window. The cluster above the average
+ * gets up to twice its request, the one below down to half, so a budget
+ * that has to be cut is cut where it costs the least throughput. The GPU
+ * utilisation has no common scale with the CPU capacity, so its request
+ * is left out of the ranking.
+ */
+static void apply_ppw_weights(int *Pbig_req, int *Plittle_req,
+			      int Pbig_in, int Plittle_in)
+{
+	int *req[] = { Pbig_req, Plittle_req };
+	int power[] = { Pbig_in, Plittle_in };
+	u64 perf[] = { cluster_perf(CL_ONE), cluster_perf(CL_ZERO) };
+	u64 ppw[ARRAY_SIZE(req)], avg = 0;
+	int i, nr = 0;
+
+	for (i = 0; i < ARRAY_SIZE(req); i++) {
+		ppw[i] = 0;
+		if (power[i] <= 0 || !perf[i])
+			continue;
+		ppw[i] = div_u64(perf[i], power[i]);
+		avg += ppw[i];
+		nr++;
+	}
+
+	/* nothing to trade between */
+	if (nr < 2 || !avg)
+		return;
+	avg = div_u64(avg, nr);
+
+	for (i = 0; i < ARRAY_SIZE(req); i++) {
+		u64 weight;
+
+		if (!ppw[i])
+			continue;
+		weight = div64_u64(ppw[i] << WEIGHT_SHIFT, avg);
+		weight = clamp_t(u64, weight, PPW_MIN_WEIGHT, PPW_MAX_WEIGHT);
+		*req[i] = ((s64)*req[i] * weight) >> WEIGHT_SHIFT;
+	}
+}
+
 static void arbiter_calc(int currT)
 {
 	int Plittle_req, Pbig_req;
@@ -1187,9 +1417,11 @@ static void arbiter_calc(int currT)
 	int big_util, little_util;
 	int gpu_freq_limit, cpu_freq_limits[NUM_CLUSTERS];
 	int cpu, online_cores;
+	int horizon, feed_forward, ctlrT;
 	struct trace_data trace_data;
 
 	struct ipa_config *config = &arbiter_data.config;
+	struct ipa_predictor *pred = &arbiter_data.pred;
 
 	/*
 	 * P*req are in mW
@@ -1226,8 +1458,27 @@ static void arbiter_calc(int currT)
 
 	extra = 0;
 
+	ctlrT = currT;
+	feed_forward = config->tdp;
+	if (config->enable_pred) {
+		int temp = arbiter_data.skin_temperature;
+		int power = Ptot_in / 100 + config->ros_power;
+
+		horizon = pred_horizon(config);
+		predictor_update(pred, temp, power);
+		pred->forecast = predictor_forecast(pred, temp, power, horizon);
+		feed_forward = predictor_budget(pred, config, temp,
+						config->control_temp * 10, horizon);
+		ctlrT = pred->forecast / 10;
+
+		apply_ppw_weights(&Pbig_req, &Plittle_req,
+				  Pbig_in, Plittle_in);
+		Pcpu_req = Plittle_req + Pbig_req;
+		Ptot_req = Pcpu_req + Pgpu_req;
+	}
+
 	if (config->enable_ctlr) {
-		Prange = F_ctlr(currT);
+		Prange = F_ctlr(ctlrT, feed_forward);
 
 		Prange = max(Prange - (int)config->ros_power, 0);
 	} else {
@@ -1776,6 +2027,17 @@ static int __init get_dt_inform_ipa(void)
 		pr_info("[IPA] ctlr.integral_reset_threshold : %d\n", (u32)proper_val);
 	}
 
+	/* the predictor is optional in DT, default it on */
+	if (of_property_read_u32(ipa_np, "enable_pred", &default_config.enable_pred))
+		default_config.enable_pred = 1;
+	if (of_property_read_u32(ipa_np, "period_ms", &default_config.period_ms))
+		default_config.period_ms = 50;
+	if (of_property_read_u32(ipa_np, "horizon_ms", &default_config.horizon_ms))
+		default_config.horizon_ms = 5000;
+	pr_info("[IPA] enable_pred : %d period_ms : %d horizon_ms : %d\n",
+		default_config.enable_pred, default_config.period_ms,
+		default_config.horizon_ms);
+
 	return 0;
 }
 #endif
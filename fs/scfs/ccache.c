@@ -0,0 +1,256 @@
+/*
+ * fs/scfs/ccache.c
+ *
+ * Copyright (C) 2014 Samsung Electronics Co., Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Decompressed cluster cache.
+ *
+ * The read buffer_cache only holds the last few clusters touched, so random
+ * readers (sqlite, apk resources) keep decompressing the same neighbouring
+ * clusters. This cache keeps recently decompressed clusters per mount, keyed
+ * by (inode number, cluster index), bounded by ccache_max and trimmed by a
+ * shrinker under memory pressure.
+ */
+
+#include <linux/hash.h>
+#include "scfs.h"
+
+#ifdef SCFS_CCACHE
+
+extern struct kmem_cache *scfs_ccache_entry_cache;
+
+static inline struct hlist_head *ccache_bucket(struct scfs_ccache *cc,
+	unsigned long ino, unsigned int clust_idx)
+{
+	return &cc->hash[hash_long(ino ^ ((unsigned long)clust_idx << 16),
+		SCFS_CCACHE_HASH_BITS)];
+}
+
+static struct scfs_ccache_entry *ccache_lookup(struct scfs_ccache *cc,
+	unsigned long ino, unsigned int clust_idx)
+{
+	struct scfs_ccache_entry *ce;
+
+	hlist_for_each_entry(ce, ccache_bucket(cc, ino, clust_idx), hash)
+		if (ce->ino == ino && ce->clust_idx == clust_idx)
+			return ce;
+	return NULL;
+}
+
+/* unlink an entry; caller frees it after dropping the lock */
+static void ccache_unlink(struct scfs_ccache *cc, struct scfs_ccache_entry *ce,
+	struct list_head *dispose)
+{
+	hlist_del(&ce->hash);
+	list_move(&ce->lru, dispose);
+	cc->nr--;
+}
+
+static void ccache_dispose(struct list_head *dispose)
+{
+	struct scfs_ccache_entry *ce, *tmp;
+
+	list_for_each_entry_safe(ce, tmp, dispose, lru) {
+		list_del(&ce->lru);
+		kfree(ce->data);
+		kmem_cache_free(scfs_ccache_entry_cache, ce);
+	}
+}
+
+/* evict from the LRU tail until at most @target entries remain */
+static unsigned int ccache_trim(struct scfs_ccache *cc, unsigned int target,
+	struct list_head *dispose)
+{
+	struct scfs_ccache_entry *ce;
+	unsigned int freed = 0;
+
+	while (cc->nr > target && !list_empty(&cc->lru)) {
+		ce = list_entry(cc->lru.prev, struct scfs_ccache_entry, lru);
+		ccache_unlink(cc, ce, dispose);
+		freed++;
+	}
+	return freed;
+}
+
+/*
+ * scfs_ccache_read_page
+ *
+ * Fills @page from a cached decompressed cluster. Returns 1 on a hit,
+ * 0 if the cluster has to be read and decompressed.
+ */
+int scfs_ccache_read_page(struct scfs_sb_info *sbi, struct page *page)
+{
+	struct scfs_ccache *cc = &sbi->ccache;
+	struct scfs_inode_info *sii = SCFS_I(page->mapping->host);
+	struct scfs_ccache_entry *ce;
+	unsigned int offset = PGOFF_IN_CLUSTER(page, sii) * PAGE_SIZE;
+	char *virt;
+
+	spin_lock(&cc->lock);
+	ce = ccache_lookup(cc, sii->vfs_inode.i_ino, PAGE_TO_CLUSTER_INDEX(page, sii));
+	if (!ce || offset + PAGE_SIZE > ce->size) {
+		cc->miss++;
+		spin_unlock(&cc->lock);
+		return 0;
+	}
+
+	list_move(&ce->lru, &cc->lru);
+	virt = kmap_atomic(page);
+	memcpy(virt, ce->data + offset, PAGE_SIZE);
+	kunmap_atomic(virt);
+	cc->hit++;
+	spin_unlock(&cc->lock);
+
+	return 1;
+}
+
+/*
+ * scfs_ccache_insert
+ *
+ * Copies a freshly decompressed cluster into the cache. This is best effort:
+ * allocation failures just skip caching. @gen is sii->ccache_gen sampled
+ * before the cluster was read; if the inode was invalidated since, or is
+ * open for write now, the data may be stale and is not cached. Only the
+ * valid part of a short last cluster is copied, the rest of its last page
+ * is zeroed like the page cache would.
+ */
+void scfs_ccache_insert(struct scfs_sb_info *sbi, struct scfs_inode_info *sii,
+	unsigned int clust_idx, const char *buf, unsigned int gen)
+{
+	struct scfs_ccache *cc = &sbi->ccache;
+	struct scfs_ccache_entry *ce;
+	loff_t i_size = i_size_read(&sii->vfs_inode);
+	loff_t start = (loff_t)clust_idx * sii->cluster_size;
+	unsigned int len;
+	LIST_HEAD(dispose);
+
+	if (!cc->max || i_size <= start)
+		return;
+	len = min_t(loff_t, sii->cluster_size, i_size - start);
+
+	ce = kmem_cache_alloc(scfs_ccache_entry_cache,
+		GFP_NOFS | __GFP_NORETRY | __GFP_NOWARN);
+	if (!ce)
+		return;
+
+	ce->size = PAGE_ALIGN(len);
+	ce->data = kmalloc(ce->size, GFP_NOFS | __GFP_NORETRY | __GFP_NOWARN);
+	if (!ce->data) {
+		kmem_cache_free(scfs_ccache_entry_cache, ce);
+		return;
+	}
+	memcpy(ce->data, buf, len);
+	memset(ce->data + len, 0, ce->size - len);
+	ce->ino = sii->vfs_inode.i_ino;
+	ce->clust_idx = clust_idx;
+
+	spin_lock(&cc->lock);
+	if (gen != sii->ccache_gen || IS_WROPENED(sii) ||
+	    ccache_lookup(cc, ce->ino, clust_idx)) {
+		/* invalidated or cached by somebody else meanwhile */
+		spin_unlock(&cc->lock);
+		kfree(ce->data);
+		kmem_cache_free(scfs_ccache_entry_cache, ce);
+		return;
+	}
+	hlist_add_head(&ce->hash, ccache_bucket(cc, ce->ino, clust_idx));
+	list_add(&ce->lru, &cc->lru);
+	cc->nr++;
+	ccache_trim(cc, cc->max, &dispose);
+	spin_unlock(&cc->lock);
+
+	ccache_dispose(&dispose);
+}
+
+/*
+ * drop every cached cluster of an inode, e.g. on truncate, write or evict,
+ * and keep readers that decompressed before from inserting stale clusters
+ */
+void scfs_ccache_invalidate(struct scfs_sb_info *sbi, struct scfs_inode_info *sii)
+{
+	struct scfs_ccache *cc = &sbi->ccache;
+	struct scfs_ccache_entry *ce, *tmp;
+	unsigned long ino = sii->vfs_inode.i_ino;
+	LIST_HEAD(dispose);
+
+	spin_lock(&cc->lock);
+	sii->ccache_gen++;
+	list_for_each_entry_safe(ce, tmp, &cc->lru, lru)
+		if (ce->ino == ino)
+			ccache_unlink(cc, ce, &dispose);
+	spin_unlock(&cc->lock);
+
+	ccache_dispose(&dispose);
+}
+
+static int scfs_ccache_shrink(struct shrinker *shrink, struct shrink_control *sc)
+{
+	struct scfs_ccache *cc = container_of(shrink, struct scfs_ccache, shrinker);
+	unsigned int nr;
+	LIST_HEAD(dispose);
+
+	spin_lock(&cc->lock);
+	if (sc->nr_to_scan) {
+		nr = cc->nr > sc->nr_to_scan ? cc->nr - sc->nr_to_scan : 0;
+		cc->shrunk += ccache_trim(cc, nr, &dispose);
+	}
+	nr = cc->nr;
+	spin_unlock(&cc->lock);
+
+	ccache_dispose(&dispose);
+
+	return nr;
+}
+
+void scfs_ccache_init(struct scfs_sb_info *sbi)
+{
+	struct scfs_ccache *cc = &sbi->ccache;
+	int i;
+
+	spin_lock_init(&cc->lock);
+	for (i = 0; i < (1 << SCFS_CCACHE_HASH_BITS); i++)
+		INIT_HLIST_HEAD(&cc->hash[i]);
+	INIT_LIST_HEAD(&cc->lru);
+	cc->nr = 0;
+	cc->max = SCFS_CCACHE_MAX_DEF;
+	cc->hit = cc->miss = cc->shrunk = 0;
+
+	cc->shrinker.shrink = scfs_ccache_shrink;
+	cc->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&cc->shrinker);
+}
+
+void scfs_ccache_destroy(struct scfs_sb_info *sbi)
+{
+	struct scfs_ccache *cc = &sbi->ccache;
+	LIST_HEAD(dispose);
+
+	/* may be called from both mount failure and kill_sb */
+	if (!cc->shrinker.shrink)
+		return;
+	unregister_shrinker(&cc->shrinker);
+	cc->shrinker.shrink = NULL;
+
+	spin_lock(&cc->lock);
+	ccache_trim(cc, 0, &dispose);
+	spin_unlock(&cc->lock);
+
+	ccache_dispose(&dispose);
+}
+
+#endif /* SCFS_CCACHE */
@@ -37,26 +37,30 @@ static struct scfs_compressor none_compr = {
 //	.capi_name = "",
 };
 
-static DEFINE_MUTEX(lzo_mutex);
-
+/*
+ * Each compressor owns one crypto tfm per cpu, so clusters can be
+ * (de)compressed concurrently without a global mutex.
+ */
 static struct scfs_compressor lzo_compr = {
 	.compr_type = SCFS_COMP_LZO,
-	.comp_mutex = &lzo_mutex,
 	.name = "lzo",
 	.capi_name = "lzo",
 };
 
-static DEFINE_MUTEX(deflate_mutex);
-static DEFINE_MUTEX(inflate_mutex);
-
 static struct scfs_compressor zlib_compr = {
 	.compr_type = SCFS_COMP_ZLIB,
-	.comp_mutex = &deflate_mutex,
-	.decomp_mutex = &inflate_mutex,
 	.name = "zlib",
 	.capi_name = "deflate",
 };
 
+static struct scfs_compressor lz4_compr = {
+	.compr_type = SCFS_COMP_LZ4,
+	.name = "lz4",
+#ifdef CONFIG_CRYPTO_LZ4
+	.capi_name = "lz4",
+#endif
+};
+
 /* All SCFS compressors */
 struct scfs_compressor *scfs_compressors[SCFS_COMP_TOTAL_TYPES];
 
@@ -65,19 +69,17 @@ int scfs_compress_crypto(const void *in_buf, size_t in_len, void *out_buf, size_
 {
 	int err = 0;
 	struct scfs_compressor *compr = scfs_compressors[compr_type];
+	struct crypto_comp *tfm;
 	unsigned int tmp_len;
 
-	if (compr_type == SCFS_COMP_NONE)
+	if (compr_type == SCFS_COMP_NONE || !compr->capi_name)
 		goto no_compr;
 
-	if (compr->comp_mutex)
-		mutex_lock(compr->comp_mutex);
+	tfm = *get_cpu_ptr(compr->cc);
 	tmp_len = (unsigned int)*out_len;
-	err = crypto_comp_compress(compr->cc, in_buf, in_len, out_buf,
-				   &tmp_len);
+	err = crypto_comp_compress(tfm, in_buf, in_len, out_buf, &tmp_len);
 	*out_len = (size_t)tmp_len;
-	if (compr->comp_mutex)
-		mutex_unlock(compr->comp_mutex);
+	put_cpu_ptr(compr->cc);
 	if (unlikely(err)) {
 		SCFS_PRINT_ERROR("cannot compress %d bytes, compressor %s, "
 			   "error %d, leave data uncompressed",
@@ -100,6 +102,7 @@ int scfs_decompress_crypto(const void *in_buf, size_t in_len, void *out_buf,
 {
 	int err;
 	struct scfs_compressor *compr;
+	struct crypto_comp *tfm;
 	unsigned int tmp_len;
 
 	if (unlikely(compr_type < 0 || compr_type >= SCFS_COMP_TOTAL_TYPES)) {
@@ -120,14 +123,11 @@ int scfs_decompress_crypto(const void *in_buf, size_t in_len, void *out_buf,
 		return 0;
 	}
 
-	if (compr->decomp_mutex)
-		mutex_lock(compr->decomp_mutex);
+	tfm = *get_cpu_ptr(compr->cc);
 	tmp_len = (unsigned int)*out_len;
-	err = crypto_comp_decompress(compr->cc, in_buf, in_len, out_buf,
-				     &tmp_len);
+	err = crypto_comp_decompress(tfm, in_buf, in_len, out_buf, &tmp_len);
 	*out_len = (size_t)tmp_len;
-	if (compr->decomp_mutex)
-		mutex_unlock(compr->decomp_mutex);
+	put_cpu_ptr(compr->cc);
 	if (err)
 		SCFS_PRINT_ERROR("cannot decompress %d bytes, compressor %s, "
 			  "error %d", in_len, compr->name, err);
@@ -135,41 +135,63 @@ int scfs_decompress_crypto(const void *in_buf, size_t in_len, void *out_buf,
 	return err;
 }
 
+/**
+ * compr_exit - de-initialize a compressor.
+ * @compr: compressor description object
+ */
+static void compr_exit(struct scfs_compressor *compr)
+{
+	struct crypto_comp *tfm;
+	int cpu;
+
+	if (!compr->cc)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		tfm = *per_cpu_ptr(compr->cc, cpu);
+		if (tfm)
+			crypto_free_comp(tfm);
+	}
+	free_percpu(compr->cc);
+	compr->cc = NULL;
+}
+
 /**
  * compr_init - initialize a compressor.
  * @compr: compressor description object
  *
- * This function initializes the requested compressor and returns zero in case
- * of success or a negative error code in case of failure.
+ * This function allocates one tfm per possible cpu for the requested
+ * compressor and returns zero in case of success or a negative error code
+ * in case of failure.
  */
 static int compr_init(struct scfs_compressor *compr)
 {
+	struct crypto_comp *tfm;
+	int cpu;
+
 	if (compr->capi_name) {
-		compr->cc = crypto_alloc_comp(compr->capi_name, 0, 0);
-		if (IS_ERR(compr->cc)) {
-			SCFS_PRINT_ERROR("cannot initialize compressor %s, error %ld",
-				  compr->name, PTR_ERR(compr->cc));
-			return PTR_ERR(compr->cc);
+		compr->cc = alloc_percpu(struct crypto_comp *);
+		if (!compr->cc)
+			return -ENOMEM;
+
+		for_each_possible_cpu(cpu) {
+			tfm = crypto_alloc_comp(compr->capi_name, 0, 0);
+			if (IS_ERR(tfm)) {
+				SCFS_PRINT_ERROR("cannot initialize compressor %s, error %ld",
+					  compr->name, PTR_ERR(tfm));
+				compr_exit(compr);
+				return PTR_ERR(tfm);
+			}
+			*per_cpu_ptr(compr->cc, cpu) = tfm;
 		}
 	}
 
 	scfs_compressors[compr->compr_type] = compr;
-	SCFS_PRINT("compr name %s(%d) got cc(%x)\n",
-		compr->capi_name, compr->compr_type, compr->cc); 
+	SCFS_PRINT("compr name %s(%d) got cc(%p)\n",
+		compr->capi_name, compr->compr_type, compr->cc);
 	return 0;
 }
 
-/**
- * compr_exit - de-initialize a compressor.
- * @compr: compressor description object
- */
-static void compr_exit(struct scfs_compressor *compr)
-{
-	if (compr->capi_name)
-		crypto_free_comp(compr->cc);
-	return;
-}
-
 int scfs_compressors_init(void)
 {
 	int err;
@@ -182,9 +204,15 @@ int scfs_compressors_init(void)
 	if (err)
 		goto out_lzo;
 
+	err = compr_init(&lz4_compr);
+	if (err)
+		goto out_zlib;
+
 	scfs_compressors[SCFS_COMP_NONE] = &none_compr;
 	return 0;
 
+out_zlib:
+	compr_exit(&zlib_compr);
 out_lzo:
 	compr_exit(&lzo_compr);
 	return err;
@@ -194,4 +222,5 @@ void scfs_compressors_exit(void)
 {
 	compr_exit(&lzo_compr);
 	compr_exit(&zlib_compr);
+	compr_exit(&lz4_compr);
 }
@@ -117,8 +117,13 @@ static int scfs_open(struct inode *inode, struct file *file)
 out:
 	if (!ret) {
 		fsstack_copy_attr_all(inode, scfs_lower_inode(inode));
-		if (file->f_flags & (O_RDWR | O_WRONLY))
+		if (file->f_flags & (O_RDWR | O_WRONLY)) {
 			MAKE_WROPENED(sii);
+#ifdef SCFS_CCACHE
+			/* appends rewrite the last cluster */
+			scfs_ccache_invalidate(sbi, sii);
+#endif
+		}
 	} else {
 		scfs_set_lower_file(file, NULL);
 		kmem_cache_free(scfs_file_info_cache, file->private_data);
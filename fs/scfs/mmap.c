@@ -69,6 +69,9 @@ static inline int _scfs_readpage(struct file *file, struct page *page, int pref_
 	struct scfs_sb_info *sbi = SCFS_S(page->mapping->host->i_sb);
 	struct scfs_cluster_buffer buffer = {NULL, NULL, NULL, NULL, 0};
 	int ret = 0, compressed = 0;
+#ifdef SCFS_CCACHE
+	unsigned int ccache_gen;
+#endif
 	int alloc_membuffer = 1;
 	int allocated_index = -1;
 	int i;
@@ -83,6 +86,17 @@ static inline int _scfs_readpage(struct file *file, struct page *page, int pref_
 	sbi->scfs_readpage_total_count++;
 #endif
 
+#ifdef SCFS_PARALLEL_COMPRESSION
+	/* written clusters still being compressed are not in the lower file */
+	if (scfs_read_pending_page(sii, page)) {
+		SetPageUptodate(page);
+		unlock_page(page);
+		SCFS_PRINT("%s<p> %d\n",
+			file->f_path.dentry->d_name.name, page->index);
+		return 0;
+	}
+#endif
+
 #if MAX_BUFFER_CACHE
 	/* search buffer_cache first in case the cluster is left cached */
 	if (pref_index >= 0 && BUFFERCACHE_HIT(sbi->buffer_cache[pref_index], page, sii)) {
@@ -147,6 +161,16 @@ static inline int _scfs_readpage(struct file *file, struct page *page, int pref_
 	}
 
 pick_slot:
+#ifdef SCFS_CCACHE
+	/* recently decompressed cluster, no need for lower I/O */
+	if (scfs_ccache_read_page(sbi, page)) {
+		SetPageUptodate(page);
+		unlock_page(page);
+		SCFS_PRINT("%s<c> %d\n",
+			file->f_path.dentry->d_name.name, page->index);
+		return 0;
+	}
+#endif
 	/* pick a slot in buffer_cache to use */
 	if (!atomic_read(&sbi->buffer_cache[sbi->read_buffer_index].is_using)) {
 		spin_lock(&sbi->buffer_cache_lock);
@@ -244,6 +268,10 @@ real_io:
 		ret = -ENOMEM;
 		goto out;
 	}
+#ifdef SCFS_CCACHE
+	/* a writer opening the file after this makes the cluster uncacheable */
+	ccache_gen = ACCESS_ONCE(sii->ccache_gen);
+#endif
 	/* read cluster from lower */
 	ret = scfs_read_cluster(file, page, buffer.c_buffer, &buffer.u_buffer, &compressed);
 
@@ -258,6 +286,13 @@ real_io:
 		goto out;
 	}
 
+#ifdef SCFS_CCACHE
+	/* clusters of files open for write may still change, don't cache them */
+	if (compressed && !IS_WROPENED(sii))
+		scfs_ccache_insert(sbi, sii, PAGE_TO_CLUSTER_INDEX(page, sii),
+			page_address(buffer.u_page), ccache_gen);
+#endif
+
 #if MAX_BUFFER_CACHE
 	/* don't need to spinlock, we have positive is_using for this buffer */
 	if (alloc_membuffer != 1)
@@ -332,6 +367,10 @@ int scfs_clear_cluster(struct inode *inode)
 	struct scfs_sb_info *sbi = SCFS_S(inode->i_sb);
 	int i;
 
+#ifdef SCFS_CCACHE
+	scfs_ccache_invalidate(sbi, SCFS_I(inode));
+#endif
+
 	for (i = 0; i < MAX_BUFFER_CACHE; i++) {
 		if (sbi->buffer_cache[i].ino == inode->i_ino) {
 			spin_lock(&sbi->buffer_cache_lock);
@@ -863,7 +902,7 @@ static int scfs_write_begin(struct file *file, struct address_space *mapping,
 				goto out;
 			}
 
-#ifndef SCFS_MULTI_THREAD_COMPRESSION
+#if !defined(SCFS_MULTI_THREAD_COMPRESSION) && !defined(SCFS_PARALLEL_COMPRESSION)
 			if (new_list) {
 				new_list->cinfo.offset =
 					info_entry->cinfo.offset +
@@ -1040,6 +1079,29 @@ static int scfs_write_end(struct file *file, struct address_space *mapping,
 			/* initialize sii->cluster_buffer */
 			memset(&sii->cluster_buffer, 0, sizeof(struct scfs_cluster_buffer));
 			atomic_sub(1, &sb_info->current_file_count);
+#elif defined(SCFS_PARALLEL_COMPRESSION)
+			mutex_lock(&sii->cinfo_mutex);
+			if (list_empty(&sii->cinfo_list)) {
+				mutex_unlock(&sii->cinfo_mutex);
+				SCFS_PRINT_ERROR("cinfo list is empty\n");
+				ret = -EINVAL;
+				goto out;
+			}
+			info_entry = list_entry(sii->cinfo_list.prev,
+					struct cinfo_entry, entry);
+
+			if (info_entry->current_cluster_idx !=
+					PAGE_TO_CLUSTER_INDEX(page,sii)) {
+				SCFS_PRINT_ERROR("Cannot find cluster info entry" \
+					"for cluster idx %d\n", PAGE_TO_CLUSTER_INDEX(page,sii));
+				ASSERT(0);
+			}
+			mutex_unlock(&sii->cinfo_mutex);
+
+			/* hand the full cluster over to a compression worker */
+			ret = scfs_queue_cluster(sii, info_entry, lower_file);
+			if (ret)
+				goto out;
 #else
 			mutex_lock(&sii->cinfo_mutex);
 
@@ -1165,6 +1227,260 @@ out:
 	return ret;
 }
 
+#ifdef SCFS_PARALLEL_COMPRESSION
+extern struct kmem_cache *scfs_pcomp_cache;
+static struct workqueue_struct *scfs_pcomp_wq;
+
+int scfs_pcomp_init(void)
+{
+	scfs_pcomp_wq = alloc_workqueue("scfs_pcomp",
+		WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	if (!scfs_pcomp_wq)
+		return -ENOMEM;
+	return 0;
+}
+
+void scfs_pcomp_exit(void)
+{
+	if (scfs_pcomp_wq)
+		destroy_workqueue(scfs_pcomp_wq);
+	scfs_pcomp_wq = NULL;
+}
+
+static void scfs_pcomp_work(struct work_struct *work)
+{
+	struct scfs_pcomp_cluster *pc =
+		container_of(work, struct scfs_pcomp_cluster, work);
+	struct scfs_sb_info *sbi = SCFS_S(pc->sii->vfs_inode.i_sb);
+
+	/* Set available buffer size because zlib care about it. */
+	pc->comp_len = PAGE_CACHE_SIZE * 8;
+	pc->ret = scfs_compress(pc->sii->comp_type, pc->cb.c_buffer,
+		pc->cb.u_buffer, pc->cb.original_size, &pc->comp_len,
+		NULL, sbi);
+	complete(&pc->done);
+}
+
+/*
+ * scfs_release_pending_cluster
+ *
+ * Gives the buffers of a written cluster back to the inode when it has none
+ * yet, so the next cluster reuses them instead of allocating; otherwise
+ * frees them.
+ */
+static void scfs_release_pending_cluster(struct scfs_inode_info *sii,
+	struct scfs_pcomp_cluster *pc)
+{
+	struct scfs_sb_info *sbi = SCFS_S(sii->vfs_inode.i_sb);
+
+	atomic64_sub(pc->cb.original_size, &sbi->current_data_size);
+
+	if (!sii->cluster_buffer.u_page && !sii->cluster_buffer.c_page) {
+		sii->cluster_buffer.u_page = pc->cb.u_page;
+		sii->cluster_buffer.u_buffer = pc->cb.u_buffer;
+		sii->cluster_buffer.c_page = pc->cb.c_page;
+		sii->cluster_buffer.c_buffer = pc->cb.c_buffer;
+		atomic_add(1, &sbi->current_file_count);
+	} else {
+		__free_pages(pc->cb.u_page, SCFS_MEMPOOL_ORDER + 1);
+		__free_pages(pc->cb.c_page, SCFS_MEMPOOL_ORDER + 1);
+	}
+	kmem_cache_free(scfs_pcomp_cache, pc);
+}
+
+static int scfs_write_pending_cluster(struct scfs_inode_info *sii,
+	struct scfs_pcomp_cluster *pc, struct file *lower_file)
+{
+	struct scfs_sb_info *sbi = SCFS_S(sii->vfs_inode.i_sb);
+	struct cinfo_entry *info_entry = pc->info_entry;
+	struct cinfo_entry *prev_info_entry;
+	size_t original_size = pc->cb.original_size;
+	size_t write_count;
+	loff_t lower_pos;
+	char *source;
+	int ret;
+
+	mutex_lock(&sii->cinfo_mutex);
+	/* offset depends on the final size of the previous cluster */
+	if (info_entry->entry.prev != &sii->cinfo_list) {
+		prev_info_entry = list_entry(info_entry->entry.prev,
+			struct cinfo_entry, entry);
+		info_entry->cinfo.offset = ALIGN(prev_info_entry->cinfo.offset +
+			prev_info_entry->cinfo.size, SCFS_CLUSTER_ALIGN_BYTE);
+	}
+
+	if (!pc->ret && pc->comp_len < original_size *
+			sbi->options.comp_threshold / 100) {
+		info_entry->cinfo.size = (__u32)pc->comp_len;
+		info_entry->pad = ALIGN(info_entry->cinfo.size,
+			SCFS_CLUSTER_ALIGN_BYTE) - info_entry->cinfo.size;
+		source = pc->cb.c_buffer;
+		if (!sii->compressed)
+			sii->compressed = 1;
+	} else {
+		/* not worth it, or compression failed: keep the raw cluster */
+		if (pc->ret)
+			SCFS_PRINT_ERROR("compression failed(%d), " \
+				"write uncompressed data.\n", pc->ret);
+		info_entry->cinfo.size = original_size;
+		info_entry->pad = 0;
+		source = pc->cb.u_buffer;
+	}
+	write_count = (size_t)info_entry->cinfo.size + info_entry->pad;
+	lower_pos = (loff_t)info_entry->cinfo.offset;
+	mutex_unlock(&sii->cinfo_mutex);
+
+	SCFS_PRINT("cluster original size = %ld, comp size = %d, pad = %d\n",
+		original_size, info_entry->cinfo.size, info_entry->pad);
+
+	ret = scfs_lower_write(lower_file, source, write_count, &lower_pos);
+	if (ret < 0) {
+		SCFS_PRINT_ERROR("write fail. ret = %d, size=%ld\n",
+			ret, write_count);
+		MAKE_META_INVALID(sii);
+		return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * scfs_flush_pending_clusters
+ *
+ * Parameters:
+ * @sii: inode whose queued clusters should be written
+ * @lower_file: lower file to write to
+ * @max_pending: number of clusters allowed to stay in flight
+ *
+ * Return:
+ * 0 if success, otherwise the first error seen
+ *
+ * Description:
+ * - Writes finished clusters to the lower file strictly in cluster order,
+ *   since each cluster's offset follows from the size of the previous one.
+ * - Stops at the first unfinished cluster unless more than @max_pending
+ *   clusters are queued; then it waits. @max_pending 0 drains everything.
+ */
+int scfs_flush_pending_clusters(struct scfs_inode_info *sii,
+	struct file *lower_file, int max_pending)
+{
+	struct scfs_pcomp_cluster *pc;
+	int ret = 0, err;
+
+	mutex_lock(&sii->pcomp_mutex);
+	while (!list_empty(&sii->pcomp_list)) {
+		pc = list_first_entry(&sii->pcomp_list,
+			struct scfs_pcomp_cluster, list);
+		if (sii->pcomp_count <= max_pending && !completion_done(&pc->done))
+			break;
+
+		wait_for_completion(&pc->done);
+		list_del(&pc->list);
+		sii->pcomp_count--;
+
+		if (!ret) {
+			err = scfs_write_pending_cluster(sii, pc, lower_file);
+			if (err)
+				ret = err;
+		}
+		scfs_release_pending_cluster(sii, pc);
+	}
+	mutex_unlock(&sii->pcomp_mutex);
+
+	return ret;
+}
+
+/* drop queued clusters without writing them, e.g. on truncate */
+void scfs_discard_pending_clusters(struct scfs_inode_info *sii)
+{
+	struct scfs_pcomp_cluster *pc, *tmp;
+
+	mutex_lock(&sii->pcomp_mutex);
+	list_for_each_entry_safe(pc, tmp, &sii->pcomp_list, list) {
+		wait_for_completion(&pc->done);
+		list_del(&pc->list);
+		sii->pcomp_count--;
+		scfs_release_pending_cluster(sii, pc);
+	}
+	mutex_unlock(&sii->pcomp_mutex);
+}
+
+/*
+ * scfs_read_pending_page
+ *
+ * Copies @page from a cluster queued for compression, whose data and offset
+ * are not in the lower file yet. The uncompressed buffer of a queued cluster
+ * stays intact until it is released, and pcomp_mutex is held by the flush
+ * across writing and releasing, so a cluster either is found here or has
+ * reached the lower file. Returns 1 if the page was filled.
+ */
+int scfs_read_pending_page(struct scfs_inode_info *sii, struct page *page)
+{
+	unsigned int clust_idx = PAGE_TO_CLUSTER_INDEX(page, sii);
+	struct scfs_pcomp_cluster *pc;
+	char *virt;
+	int found = 0;
+
+	if (list_empty(&sii->pcomp_list))
+		return 0;
+
+	mutex_lock(&sii->pcomp_mutex);
+	list_for_each_entry(pc, &sii->pcomp_list, list) {
+		if (pc->info_entry->current_cluster_idx != clust_idx)
+			continue;
+
+		virt = kmap_atomic(page);
+		memcpy(virt, pc->cb.u_buffer +
+			PGOFF_IN_CLUSTER(page, sii) * PAGE_SIZE, PAGE_SIZE);
+		kunmap_atomic(virt);
+		found = 1;
+		break;
+	}
+	mutex_unlock(&sii->pcomp_mutex);
+
+	return found;
+}
+
+/*
+ * scfs_queue_cluster
+ *
+ * Moves the full cluster buffer of @sii to a compression worker. The inode
+ * gets new buffers on the next scfs_get_comp_buffer(), and finished clusters
+ * are written out in order, waiting only if too many are in flight.
+ */
+int scfs_queue_cluster(struct scfs_inode_info *sii, struct cinfo_entry *info_entry,
+	struct file *lower_file)
+{
+	struct scfs_sb_info *sbi = SCFS_S(sii->vfs_inode.i_sb);
+	struct scfs_pcomp_cluster *pc;
+
+	pc = kmem_cache_alloc(scfs_pcomp_cache, GFP_KERNEL);
+	if (!pc) {
+		SCFS_PRINT_ERROR("scfs_pcomp_cluster alloc failed\n");
+		return -ENOMEM;
+	}
+
+	INIT_WORK(&pc->work, scfs_pcomp_work);
+	init_completion(&pc->done);
+	pc->sii = sii;
+	pc->info_entry = info_entry;
+	pc->cb = sii->cluster_buffer;
+	pc->comp_len = 0;
+	pc->ret = 0;
+
+	memset(&sii->cluster_buffer, 0, sizeof(struct scfs_cluster_buffer));
+	atomic_sub(1, &sbi->current_file_count);
+
+	mutex_lock(&sii->pcomp_mutex);
+	list_add_tail(&pc->list, &sii->pcomp_list);
+	sii->pcomp_count++;
+	mutex_unlock(&sii->pcomp_mutex);
+	queue_work(scfs_pcomp_wq, &pc->work);
+
+	return scfs_flush_pending_clusters(sii, lower_file, SCFS_PCOMP_MAX_INFLIGHT);
+}
+#endif
+
 #ifdef SCFS_MULTI_THREAD_COMPRESSION
 int smtc_init(struct scfs_sb_info *sbi)
 {
@@ -36,6 +36,7 @@
 #include <linux/statfs.h>
 #include "scfs.h"
 #include <linux/lzo.h>
+#include <linux/lz4.h>
 #include <linux/ctype.h>
 
 struct kmem_cache *scfs_file_info_cache;
@@ -48,6 +49,14 @@ struct kmem_cache *scfs_info_entry_list;
 struct kmem_cache *scfs_cbm_cache;
 #endif
 
+#ifdef SCFS_PARALLEL_COMPRESSION
+struct kmem_cache *scfs_pcomp_cache;
+#endif
+
+#ifdef SCFS_CCACHE
+struct kmem_cache *scfs_ccache_entry_cache;
+#endif
+
 /* LZO must be enabled */
 #if (!defined(CONFIG_LZO_DECOMPRESS) || !defined(CONFIG_LZO_COMPRESS))
 #error "LZO library needs to be enabled!"
@@ -59,7 +68,8 @@ const char *tfm_names[SCFS_COMP_TOTAL_TYPES] =
 	"lzo",		/* lzo */
 	"zlib",		/* zlib */ 
 	"deflate",
-	"fastlzo"	/* lzo */
+	"fastlzo",	/* lzo */
+	"lz4"		/* lz4 */
 };
 
 extern struct scfs_compressor *scfs_compressors[SCFS_COMP_TOTAL_TYPES];
@@ -315,6 +325,11 @@ int scfs_parse_options(struct scfs_sb_info *sbi, char *options)
 #ifdef CONFIG_CRYPTO_FASTLZO
 			else if (!strcmp(type, "fastlzo"))
 				sbi->options.comp_type = SCFS_COMP_FASTLZO;
+#endif
+#if (defined(CONFIG_SCFS_USE_CRYPTO) && defined(CONFIG_CRYPTO_LZ4)) || \
+	(!defined(CONFIG_SCFS_USE_CRYPTO) && defined(CONFIG_LZ4_COMPRESS))
+			else if (!strcmp(type, "lz4"))
+				sbi->options.comp_type = SCFS_COMP_LZ4;
 #endif
 			else {
 				SCFS_PRINT_ERROR("invalid compression type\n");
@@ -585,6 +600,17 @@ int scfs_decompress(enum comp_type algo, char *buf_c, char *buf_u, size_t len,
 			ret = -EIO;
 		}
 		break;
+#ifdef CONFIG_LZ4_DECOMPRESS
+	case SCFS_COMP_LZ4:
+		ret = lz4_decompress_unknownoutputsize(buf_c, len, buf_u, actual);
+		if (ret) {
+			SCFS_PRINT_ERROR("lz4 decompress error! "
+					"ret %d len %d tmp_len %d\n",
+					ret, len, *actual);
+			ret = -EIO;
+		}
+		break;
+#endif
 	default:
 		SCFS_PRINT_ERROR("SCFS does not support this algorithm type!"
 				"algorithm_type : %d\n", algo);
@@ -618,6 +644,9 @@ int scfs_compress(enum comp_type algo, char *buf_c, char *buf_u, size_t len,
 	size_t *actual, void *workdata, struct scfs_sb_info *sbi)
 {
 	int ret = 0;
+#ifndef CONFIG_SCFS_USE_CRYPTO
+	void **pcpu_workdata = NULL;
+#endif
 
 	ASSERT(algo < SCFS_COMP_TOTAL_TYPES);
 
@@ -630,35 +659,92 @@ int scfs_compress(enum comp_type algo, char *buf_c, char *buf_u, size_t len,
 			*actual = len; // We use raw data if compression was failed.
 	}
 #else	// Use kernel libraries directly
+	/* callers without a private workspace borrow this cpu's one */
+	if (!workdata) {
+		pcpu_workdata = get_cpu_ptr(sbi->scfs_workdata);
+		workdata = *pcpu_workdata;
+	}
+
 	switch (algo) {
 	case SCFS_COMP_LZO:
-		if (!workdata) {
-			spin_lock(&sbi->workdata_lock);
-			memset(sbi->scfs_workdata, 0, LZO1X_MEM_COMPRESS);
-			ret = lzo1x_1_compress(buf_u, len, buf_c, actual, sbi->scfs_workdata);
-			spin_unlock(&sbi->workdata_lock);
-		} else {
-			memset(workdata, 0, LZO1X_MEM_COMPRESS);
-			ret = lzo1x_1_compress(buf_u, len, buf_c, actual, workdata);
-		}
-
+		memset(workdata, 0, LZO1X_MEM_COMPRESS);
+		ret = lzo1x_1_compress(buf_u, len, buf_c, actual, workdata);
 		if (ret) {
 			SCFS_PRINT("lzo compress error! "
 				"ret %d len %d tmp_len %d\n", ret, len, *actual);
 			ret = -EIO;
 		}
 		break;
+#ifdef CONFIG_LZ4_COMPRESS
+	case SCFS_COMP_LZ4:
+		ret = lz4_compress(buf_u, len, buf_c, actual, workdata);
+		if (ret) {
+			SCFS_PRINT("lz4 compress error! "
+				"ret %d len %d tmp_len %d\n", ret, len, *actual);
+			ret = -EIO;
+		}
+		break;
+#endif
 	default:
 		SCFS_PRINT_ERROR("SCFS does not support this algorithm type!"
 				"algorithm_type : %d\n", algo);
 		ret = -EINVAL;
 		break;
 	}
+
+	if (pcpu_workdata)
+		put_cpu_ptr(sbi->scfs_workdata);
 #endif
 
 	return ret;
 }
 
+#ifndef CONFIG_SCFS_USE_CRYPTO
+void scfs_free_workdata(struct scfs_sb_info *sbi)
+{
+	int cpu;
+
+	if (!sbi->scfs_workdata)
+		return;
+
+	for_each_possible_cpu(cpu)
+		vfree(*per_cpu_ptr(sbi->scfs_workdata, cpu));
+	free_percpu(sbi->scfs_workdata);
+	sbi->scfs_workdata = NULL;
+}
+
+/*
+ * scfs_alloc_workdata
+ *
+ * Allocates one compressor workspace per possible cpu. A file may have been
+ * created with another algorithm than the one given at mount time, so each
+ * workspace is big enough for any of the supported compressors.
+ */
+int scfs_alloc_workdata(struct scfs_sb_info *sbi)
+{
+	size_t size = max_t(size_t, LZO1X_MEM_COMPRESS, LZ4_MEM_COMPRESS);
+	void *workdata;
+	int cpu;
+
+	sbi->scfs_workdata = alloc_percpu(void *);
+	if (!sbi->scfs_workdata)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		workdata = vmalloc(size);
+		if (!workdata) {
+			SCFS_PRINT_ERROR("vmalloc for compressor workmem failed, "
+					"len %zu\n", size);
+			scfs_free_workdata(sbi);
+			return -ENOMEM;
+		}
+		*per_cpu_ptr(sbi->scfs_workdata, cpu) = workdata;
+	}
+
+	return 0;
+}
+#endif
+
 struct page *scfs_alloc_mempool_buffer(struct scfs_sb_info *sbi)
 {
 	struct page *ret = mempool_alloc(sbi->mempool, 
@@ -801,18 +887,27 @@ int scfs_write_meta(struct file *file)
 	loff_t pos;
 	size_t tmp_len;
 
-#ifdef SCFS_MULTI_THREAD_COMPRESSION
+#if defined(SCFS_MULTI_THREAD_COMPRESSION) || defined(SCFS_PARALLEL_COMPRESSION)
 	struct cinfo_entry *prev_info_entry = NULL;
 #endif
 
 	ret = scfs_initialize_lower_file(file->f_dentry, &lower_file, O_WRONLY); 
 	if (ret) {
 		SCFS_PRINT_ERROR("err in get_lower_file %s\n", file->f_dentry->d_name.name);
+#ifdef SCFS_PARALLEL_COMPRESSION
+		/* nowhere to write them, but the workers must not outlive sii */
+		scfs_discard_pending_clusters(sii);
+#endif
 		return ret;
 	}
 
 	SCFS_PRINT("filename : %s\n", lower_file->f_dentry->d_name.name);
 
+#ifdef SCFS_PARALLEL_COMPRESSION
+	/* clusters still being compressed must hit the lower file first */
+	ret = scfs_flush_pending_clusters(sii, lower_file, 0);
+#endif
+
 	mutex_lock(&sii->cinfo_mutex);
 	if (list_empty(&sii->cinfo_list)) {
 		SCFS_PRINT("cinfo_list is empty\n");
@@ -821,6 +916,19 @@ int scfs_write_meta(struct file *file)
 	}
 	last = list_entry(sii->cinfo_list.prev, struct cinfo_entry, entry);
 
+#ifdef SCFS_PARALLEL_COMPRESSION
+	if (ret)
+		goto free_out;
+
+	/* offset of the last cluster is known only after the previous one is written */
+	if (last->entry.prev != &sii->cinfo_list) {
+		prev_info_entry = list_entry(last->entry.prev,
+			struct cinfo_entry, entry);
+		last->cinfo.offset = ALIGN(prev_info_entry->cinfo.offset +
+			prev_info_entry->cinfo.size, SCFS_CLUSTER_ALIGN_BYTE);
+	}
+#endif
+
 #ifdef SCFS_MULTI_THREAD_COMPRESSION
 	scfs_write_compress_all_cluster(sii, lower_file);
 #endif
@@ -1111,6 +1219,9 @@ int scfs_truncate(struct dentry *dentry, loff_t size)
 	truncate_setsize(inode, ia.ia_size);
 	/* clear buffer_cache */
 	scfs_clear_cluster(inode);
+#ifdef SCFS_PARALLEL_COMPRESSION
+	scfs_discard_pending_clusters(sii);
+#endif
 	mutex_lock(&sii->cinfo_mutex);
 
 	list_for_each_safe(cluster_info, tmp, &sii->cinfo_list) {
@@ -1271,6 +1382,20 @@ static struct scfs_cache_info {
 		.size = sizeof(struct scfs_cluster_buffer_mtc),
 	},
 #endif
+#ifdef SCFS_PARALLEL_COMPRESSION
+	{
+		.cache = &scfs_pcomp_cache,
+		.name = "scfs_pcomp_cache",
+		.size = sizeof(struct scfs_pcomp_cluster),
+	},
+#endif
+#ifdef SCFS_CCACHE
+	{
+		.cache = &scfs_ccache_entry_cache,
+		.name = "scfs_ccache_entry_cache",
+		.size = sizeof(struct scfs_ccache_entry),
+	},
+#endif
 };
 
 void scfs_free_kmem_caches(void)
@@ -51,6 +51,9 @@
 #include <linux/delay.h>
 #include <linux/kernel.h>
 #include <linux/path.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
 
 extern const struct address_space_operations scfs_aops;
 extern const struct inode_operations scfs_symlink_iops;
@@ -130,6 +133,13 @@ extern struct kmem_cache *scfs_sb_info_cache;
 #define SMB_THREAD_THRESHOLD_4		MAX_PAGE_BUFFER_SIZE_SMB / 16 	// 128 pages
 #endif
  
+/* shrinker-managed cache of decompressed clusters for random reads */
+#define SCFS_CCACHE
+#ifdef SCFS_CCACHE
+#define SCFS_CCACHE_HASH_BITS		8
+#define SCFS_CCACHE_MAX_DEF		256	// clusters, 4MB w/ 16KB clusters
+#endif
+
 //#define SCFS_NOTIFY_RANDOM_READ
 //#define SCFS_REMOVE_NO_COMPRESSED_UPPER_MEMCPY
 
@@ -141,6 +151,20 @@ extern struct kmem_cache *scfs_sb_info_cache;
 #undef SCFS_MULTI_THREAD_COMPRESSION
 #endif
 
+/*
+ * Full clusters are compressed on an unbound workqueue with per-cpu
+ * compressor workspaces and written back in cluster order, so that a
+ * single writer keeps several cores busy. Exclusive with ver. 1.3 smtc.
+ */
+#ifndef SCFS_MULTI_THREAD_COMPRESSION
+#define SCFS_PARALLEL_COMPRESSION
+#endif
+
+#ifdef SCFS_PARALLEL_COMPRESSION
+/* # of clusters a writer may have in flight before it waits for the oldest */
+#define SCFS_PCOMP_MAX_INFLIGHT		(SCFS_CPUS * 2)
+#endif
+
 #ifdef SCFS_MULTI_THREAD_COMPRESSION
 #define SMTC_THREAD_THRESHOLD_2		4	// # of clusters
 #define SMTC_THREAD_THRESHOLD_3		8	// # of clusters
@@ -160,9 +184,7 @@ extern struct kmem_cache *scfs_sb_info_cache;
 struct scfs_compressor {
 	int compr_type;
 	const char *name;
-	struct crypto_comp *cc;
-	struct mutex *comp_mutex;
-	struct mutex *decomp_mutex;
+	struct crypto_comp * __percpu *cc;	/* one tfm per cpu */
 	const char *capi_name;
 };
 
@@ -172,6 +194,7 @@ enum comp_type {
 	SCFS_COMP_ZLIB,
 	SCFS_COMP_BZIP2,
 	SCFS_COMP_FASTLZO,
+	SCFS_COMP_LZ4,
 	SCFS_COMP_TOTAL_TYPES,
 };
 
@@ -211,6 +234,29 @@ struct read_buffer_cache {
 	atomic_t is_using;
 };
 
+#ifdef SCFS_CCACHE
+struct scfs_ccache_entry {
+	struct hlist_node hash;
+	struct list_head lru;
+	unsigned long ino;
+	unsigned int clust_idx;
+	unsigned int size;
+	char *data;
+};
+
+struct scfs_ccache {
+	spinlock_t lock;
+	struct hlist_head hash[1 << SCFS_CCACHE_HASH_BITS];
+	struct list_head lru;		/* most recently used first */
+	u32 nr;
+	u32 max;			/* tunable, 0 disables caching */
+	u64 hit;
+	u64 miss;
+	u64 shrunk;
+	struct shrinker shrinker;
+};
+#endif
+
 struct scfs_mount_options
 {
 	int flags;
@@ -236,9 +282,13 @@ struct scfs_sb_info
 	int read_buffer_index;
 #endif
 
+#ifdef SCFS_CCACHE
+	struct scfs_ccache ccache;
+#endif
+
 #ifndef CONFIG_SCFS_USE_CRYPTO
-	void *scfs_workdata;
-	spinlock_t workdata_lock;
+	/* per-cpu compressor workspace, sized for both lzo and lz4 */
+	void * __percpu *scfs_workdata;
 #endif
 
 #ifdef CONFIG_DEBUG_FS
@@ -315,6 +365,20 @@ struct scfs_cluster_buffer
 	size_t original_size;
 };
 
+#ifdef SCFS_PARALLEL_COMPRESSION
+struct scfs_pcomp_cluster
+{
+	struct work_struct work;
+	struct completion done;
+	struct list_head list;
+	struct scfs_inode_info *sii;
+	struct cinfo_entry *info_entry;
+	struct scfs_cluster_buffer cb;
+	size_t comp_len;
+	int ret;
+};
+#endif
+
 #ifdef SCFS_MULTI_THREAD_COMPRESSION
 struct scfs_cluster_buffer_mtc
 {
@@ -340,6 +404,14 @@ struct scfs_inode_info
  	struct scfs_cluster_buffer cluster_buffer;
  	struct list_head cinfo_list;
 	unsigned char compressed;
+#ifdef SCFS_PARALLEL_COMPRESSION
+	struct mutex pcomp_mutex;
+	struct list_head pcomp_list;		/* clusters in flight, in file order */
+	int pcomp_count;
+#endif
+#ifdef SCFS_CCACHE
+	unsigned int ccache_gen;		/* bumped under ccache lock on invalidate */
+#endif
 #ifdef SCFS_MULTI_THREAD_COMPRESSION
 	struct list_head cbm_list;
 	struct list_head *cbm_list_comp;	/* cbm to compress */
@@ -617,6 +689,12 @@ int scfs_decompress(enum comp_type algo, char *buf_c, char *buf_u,
 int scfs_compress(enum comp_type algo, char *buf_c, char *buf_u, size_t len,
 	size_t *actual, void *workdata, struct scfs_sb_info *sbi);
 
+#ifndef CONFIG_SCFS_USE_CRYPTO
+int scfs_alloc_workdata(struct scfs_sb_info *sbi);
+
+void scfs_free_workdata(struct scfs_sb_info *sbi);
+#endif
+
 struct page *scfs_alloc_mempool_buffer(struct scfs_sb_info *sbi);
 
 void scfs_free_mempool_buffer(struct page *p, struct scfs_sb_info *sbi);
@@ -689,6 +767,26 @@ void smb_destroy(struct scfs_sb_info *sbi);
 int smb_thread(void *data);
 #endif
 
+#ifdef SCFS_CCACHE
+void scfs_ccache_init(struct scfs_sb_info *sbi);
+void scfs_ccache_destroy(struct scfs_sb_info *sbi);
+int scfs_ccache_read_page(struct scfs_sb_info *sbi, struct page *page);
+void scfs_ccache_insert(struct scfs_sb_info *sbi, struct scfs_inode_info *sii,
+	unsigned int clust_idx, const char *buf, unsigned int gen);
+void scfs_ccache_invalidate(struct scfs_sb_info *sbi, struct scfs_inode_info *sii);
+#endif
+
+#ifdef SCFS_PARALLEL_COMPRESSION
+int scfs_pcomp_init(void);
+void scfs_pcomp_exit(void);
+int scfs_queue_cluster(struct scfs_inode_info *sii, struct cinfo_entry *info_entry,
+	struct file *lower_file);
+int scfs_flush_pending_clusters(struct scfs_inode_info *sii,
+	struct file *lower_file, int max_pending);
+void scfs_discard_pending_clusters(struct scfs_inode_info *sii);
+int scfs_read_pending_page(struct scfs_inode_info *sii, struct page *page);
+#endif
+
 #ifdef SCFS_MULTI_THREAD_COMPRESSION
 extern void wakeup_smtc_thread(struct scfs_sb_info *sb_info);
 extern int smtc_init(struct scfs_sb_info *sbi);
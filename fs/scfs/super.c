@@ -88,6 +88,10 @@ static const char * supported_comp_types = "lzo"
 #endif
 #ifdef CONFIG_CRYPTO_FASTLZO
 	",fastlzo"
+#endif
+#if (defined(CONFIG_SCFS_USE_CRYPTO) && defined(CONFIG_CRYPTO_LZ4)) || \
+	(!defined(CONFIG_SCFS_USE_CRYPTO) && defined(CONFIG_LZ4_COMPRESS))
+	",lz4"
 #endif
 	"\n";
 
@@ -128,6 +132,12 @@ static struct inode *scfs_alloc_inode(struct super_block *sb)
 	mutex_init(&sii->cinfo_mutex);
 	INIT_LIST_HEAD(&sii->cinfo_list);
 
+#ifdef SCFS_PARALLEL_COMPRESSION
+	mutex_init(&sii->pcomp_mutex);
+	INIT_LIST_HEAD(&sii->pcomp_list);
+	sii->pcomp_count = 0;
+#endif
+
 #ifdef SCFS_MULTI_THREAD_COMPRESSION
 	INIT_LIST_HEAD(&sii->cbm_list);
 	sii->cbm_list_comp_count = 0;
@@ -179,6 +189,10 @@ static void scfs_evict_inode(struct inode *inode)
 	clear_inode(inode);
 #else
 	end_writeback(inode);
+#endif
+#ifdef SCFS_PARALLEL_COMPRESSION
+	/* wait for compression workers still holding the inode's clusters */
+	scfs_discard_pending_clusters(sii);
 #endif
 	scfs_clear_cluster(inode);
 	/* to conserve memory, evicted inode will throw out the cluster info */
@@ -233,6 +247,9 @@ static int scfs_show_options(struct seq_file *m, struct dentry *root)
 	case SCFS_COMP_FASTLZO:
 		seq_printf(m, ",comp_type=fastlzo");
 		break;
+	case SCFS_COMP_LZ4:
+		seq_printf(m, ",comp_type=lz4");
+		break;
 	default:
 		break;
 	}
@@ -296,6 +313,19 @@ static int scfs_debugfs_init(struct super_block *sb)
 		debugfs_root, &sbi->kmcached_size);
 #endif
 
+#ifdef SCFS_CCACHE
+	debugfs_create_u32("ccache_max", S_IRUGO | S_IWUSR,
+		debugfs_root, &sbi->ccache.max);
+	debugfs_create_u32("ccache_nr", S_IRUGO,
+		debugfs_root, &sbi->ccache.nr);
+	debugfs_create_u64("ccache_hit", S_IRUGO,
+		debugfs_root, &sbi->ccache.hit);
+	debugfs_create_u64("ccache_miss", S_IRUGO,
+		debugfs_root, &sbi->ccache.miss);
+	debugfs_create_u64("ccache_shrunk", S_IRUGO,
+		debugfs_root, &sbi->ccache.shrunk);
+#endif
+
 #ifdef SCFS_ASYNC_READ_PAGES
 	debugfs_create_u64("scfs_readpage_total_count", S_IRUGO,
 		debugfs_root, &sbi->scfs_readpage_total_count);
@@ -481,20 +511,13 @@ static struct dentry *scfs_mount(struct file_system_type *fs_type, int flags,
 #endif
 
 #ifndef CONFIG_SCFS_USE_CRYPTO
-	switch (sbi->options.comp_type) {
-	case SCFS_COMP_LZO:
-		sbi->scfs_workdata = vmalloc(LZO1X_MEM_COMPRESS);
-		if (!sbi->scfs_workdata) {
-			SCFS_PRINT_ERROR("vmalloc for lzo workmem failed, "
-					"len %d\n", LZO1X_MEM_COMPRESS);
-			ret = -ENOMEM;
-			goto out_deactivate;
-		}
-		break;
-	default:
-		break;
-	}
-	spin_lock_init(&sbi->workdata_lock);
+	ret = scfs_alloc_workdata(sbi);
+	if (ret)
+		goto out_deactivate;
+#endif
+
+#ifdef SCFS_CCACHE
+	scfs_ccache_init(sbi);
 #endif
 
 #ifdef SCFS_ASYNC_READ_PAGES
@@ -539,7 +562,12 @@ static struct dentry *scfs_mount(struct file_system_type *fs_type, int flags,
 out_pathput:
 	path_put(&path);	
 out_workdata:
-	vfree(sbi->scfs_workdata);
+#ifdef SCFS_CCACHE
+	scfs_ccache_destroy(sbi);
+#endif
+#ifndef CONFIG_SCFS_USE_CRYPTO
+	scfs_free_workdata(sbi);
+#endif
 out_deactivate:
 	deactivate_locked_super(sb);
 out_free:
@@ -564,9 +592,12 @@ static void scfs_kill_block_super(struct super_block *sb)
 	smb_destroy(sbi);
 #endif
 
-#ifdef CONFIG_SCFS_USE_CRYPTO
-	if (sbi->scfs_workdata)
-		vfree(sbi->scfs_workdata);
+#ifdef SCFS_CCACHE
+	scfs_ccache_destroy(sbi);
+#endif
+
+#ifndef CONFIG_SCFS_USE_CRYPTO
+	scfs_free_workdata(sbi);
 #endif
 
 	if (sbi->mempool)
@@ -785,10 +816,18 @@ static int __init scfs_init(void)
 	}
 #endif
 
+#ifdef SCFS_PARALLEL_COMPRESSION
+	ret = scfs_pcomp_init();
+	if (ret) {
+		SCFS_PRINT_ERROR("compression workqueue init failed\n");
+		goto out_do_scfs_compressor_exit;
+	}
+#endif
+
 	ret = do_sysfs_registration();
 	if (ret) {
 		SCFS_PRINT_ERROR("sysfs registration failed\n");
-		goto out_do_scfs_compressor_exit;
+		goto out_pcomp_exit;
 	}
 
 /*
@@ -813,6 +852,10 @@ out_destroy_kthread:
 	*/
 out_do_sysfs_unregistration:
 	do_sysfs_unregistration();
+out_pcomp_exit:
+#ifdef SCFS_PARALLEL_COMPRESSION
+	scfs_pcomp_exit();
+#endif
 out_do_scfs_compressor_exit:
 #ifdef CONFIG_SCFS_USE_CRYPTO
 	scfs_compressors_exit();
@@ -828,6 +871,9 @@ static void __exit scfs_exit(void)
 	//scfs_destroy_kthread();
 	do_sysfs_unregistration();
 	unregister_filesystem(&scfs_fs_type);
+#ifdef SCFS_PARALLEL_COMPRESSION
+	scfs_pcomp_exit();
+#endif
 #ifdef CONFIG_SCFS_USE_CRYPTO
 	scfs_compressors_exit();
 #endif
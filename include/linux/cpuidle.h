@@ -208,6 +208,22 @@ static inline void cpuidle_unregister_governor(struct cpuidle_governor *gov) { }
 
 #endif
 
+#ifdef CONFIG_CPU_IDLE_GOV_HISTORY
+
+extern void cpuidle_history_report(int cpu, int cluster_down, int aborted);
+extern bool cpuidle_history_cluster_idle(const struct cpumask *mask,
+					 unsigned int residency);
+
+#else
+
+static inline void cpuidle_history_report(int cpu, int cluster_down,
+					  int aborted) { }
+static inline bool cpuidle_history_cluster_idle(const struct cpumask *mask,
+						unsigned int residency)
+{return true;}
+
+#endif
+
 #ifdef CONFIG_ARCH_HAS_CPU_RELAX
 #define CPUIDLE_DRIVER_STATE_START	1
 #else
@@ -158,6 +158,7 @@ struct mmc_async_req {
 	 * Returns 0 if success otherwise non zero.
 	 */
 	int (*err_check) (struct mmc_card *, struct mmc_async_req *);
+	ktime_t			issue_time;	/* queued to the card (CMDQ) */
 };
 
 /**
@@ -204,6 +205,29 @@ struct mmc_supply {
 #define EMMC_MAX_QUEUE_DEPTH		(16)
 #define EMMC_MIN_RT_CLASS_TAG_COUNT	(1)
 
+#define MMC_QUEUE_LAT_BUCKETS		16
+
+/**
+ * mmc_queue_stats - command queue and packed command statistics
+ * @depth		tasks already in flight when a task is queued
+ * @lat			task latency from CMD44/45 to completion, bucket n
+ *			counts [2^n, 2^(n+1)) us, indexed by READ/WRITE
+ * @nr			completed tasks
+ * @total_us		sum of the task latencies
+ * @max_us		largest task latency
+ * @packed_cmds		packed write commands issued
+ * @packed_reqs		requests carried by packed write commands
+ */
+struct mmc_queue_stats {
+	unsigned long		depth[EMMC_MAX_QUEUE_DEPTH + 1];
+	unsigned long		lat[2][MMC_QUEUE_LAT_BUCKETS];
+	unsigned long		nr[2];
+	u64			total_us[2];
+	u64			max_us[2];
+	unsigned long		packed_cmds;
+	unsigned long		packed_reqs;
+};
+
 struct mmc_host {
 	struct device		*parent;
 	struct device		class_dev;
@@ -409,6 +433,7 @@ struct mmc_host {
 	struct mmc_request	chk_mrq;
 	struct mmc_command	que_cmd;
 	struct mmc_request	que_mrq;
+	struct mmc_queue_stats	queue_stats;
 
 #ifdef CONFIG_FAIL_MMC_REQUEST
 	struct fault_attr	fail_mmc_request;
@@ -1015,6 +1015,13 @@ struct sched_avg {
 #ifdef CONFIG_SCHED_HMP
 	u64 hmp_last_up_migration;
 	u64 hmp_last_down_migration;
+	u64 hmp_migrate_start;		/* local_clock() of the last HMP move */
+	u64 hmp_last_runtime;		/* sum_exec_runtime at the last HMP move */
+	u64 hmp_residency;		/* runtime between HMP moves, EWMA */
+	u64 hmp_migration_cost;		/* estimated cost of all HMP moves, ns */
+	u32 hmp_nr_up_migrations;
+	u32 hmp_nr_down_migrations;
+	u32 hmp_nr_skipped_migrations;	/* reversals that would not pay off */
 #endif
 	u32 usage_avg_sum;
 };
@@ -1176,6 +1183,11 @@ struct task_struct {
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 	struct sched_info sched_info;
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	/* rq clock when the task started waiting to run, 0 when not waiting */
+	u64 sched_lat_queued;
+	int sched_lat_wakeup;
+#endif
 
 	struct list_head tasks;
 #ifdef CONFIG_SMP
@@ -822,10 +822,98 @@ static void set_load_weight(struct task_struct *p)
 	load->inv_weight = prio_to_wmult[prio];
 }
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/*
+ * Runqueue latency histograms. A task is stamped with the rq clock when it
+ * starts waiting: when it is enqueued (woken or new) and when it is preempted
+ * but stays runnable. The stamp survives migration, as the rq clocks of all
+ * CPUs follow the same sched_clock(). The wait ends in sched_lat_arrive()
+ * and is accounted on the CPU the task runs on, which is also the only CPU
+ * writing that histogram, with its rq lock held.
+ */
+static inline void sched_lat_queued(struct rq *rq, struct task_struct *p,
+				    int flags)
+{
+	/* a running task requeued by e.g. set_user_nice() is not waiting */
+	if (p->sched_lat_queued || task_current(rq, p))
+		return;
+
+	p->sched_lat_queued = rq->clock;
+	p->sched_lat_wakeup = flags & ENQUEUE_WAKEUP;
+}
+
+static inline void sched_lat_dequeued(struct task_struct *p, int flags)
+{
+	if (flags & DEQUEUE_SLEEP)
+		p->sched_lat_queued = 0;
+}
+
+static inline void
+__sched_lat_account(struct sched_lat_hist *h, int type, int idx, u64 delta)
+{
+	h->bucket[type][idx]++;
+	h->sum[type] += delta;
+	if (delta > h->max[type])
+		h->max[type] = delta;
+}
+
+static void sched_lat_account(struct sched_lat_hist *h, int idx, u64 delta,
+			      int wakeup)
+{
+	__sched_lat_account(h, SCHED_LAT_WAIT, idx, delta);
+	if (wakeup)
+		__sched_lat_account(h, SCHED_LAT_WAKEUP, idx, delta);
+}
+
+static void sched_lat_arrive(struct rq *rq, struct task_struct *p)
+{
+	s64 delta;
+	int idx;
+
+	if (!p->sched_lat_queued)
+		return;
+
+	delta = rq->clock - p->sched_lat_queued;
+	p->sched_lat_queued = 0;
+	if (delta < 0)
+		delta = 0;
+
+	/* bucket 0 is < 1us, bucket i is [2^(i-1), 2^i) us */
+	idx = min_t(int, fls64((u64)delta >> 10), SCHED_LAT_BUCKETS - 1);
+
+	sched_lat_account(&rq->lat_hist, idx, delta, p->sched_lat_wakeup);
+#ifdef CONFIG_CGROUP_SCHED
+	sched_lat_account(per_cpu_ptr(task_group(p)->lat_hist, cpu_of(rq)),
+			  idx, delta, p->sched_lat_wakeup);
+#endif
+}
+
+static inline void
+sched_lat_switch(struct rq *rq, struct task_struct *prev,
+		 struct task_struct *next)
+{
+	if (prev != rq->idle && prev->state == TASK_RUNNING) {
+		prev->sched_lat_queued = rq->clock;
+		prev->sched_lat_wakeup = 0;
+	}
+
+	if (next != rq->idle)
+		sched_lat_arrive(rq, next);
+}
+#else
+static inline void sched_lat_queued(struct rq *rq, struct task_struct *p,
+				    int flags) { }
+static inline void sched_lat_dequeued(struct task_struct *p, int flags) { }
+static inline void
+sched_lat_switch(struct rq *rq, struct task_struct *prev,
+		 struct task_struct *next) { }
+#endif /* CONFIG_SCHED_LATENCY_HIST */
+
 static void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_queued(p);
+	sched_lat_queued(rq, p, flags);
 	p->sched_class->enqueue_task(rq, p, flags);
 }
 
@@ -833,6 +921,7 @@ static void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_dequeued(p);
+	sched_lat_dequeued(p, flags);
 	p->sched_class->dequeue_task(rq, p, flags);
 }
 
@@ -1679,6 +1768,13 @@ static void __sched_fork(struct task_struct *p)
 #ifdef CONFIG_SCHED_HMP
 	p->se.avg.hmp_last_up_migration = 0;
 	p->se.avg.hmp_last_down_migration = 0;
+	p->se.avg.hmp_migrate_start = 0;
+	p->se.avg.hmp_last_runtime = 0;
+	p->se.avg.hmp_residency = 0;
+	p->se.avg.hmp_migration_cost = 0;
+	p->se.avg.hmp_nr_up_migrations = 0;
+	p->se.avg.hmp_nr_down_migrations = 0;
+	p->se.avg.hmp_nr_skipped_migrations = 0;
 #else
 	p->se.avg.runnable_avg_period = 0;
 	p->se.avg.runnable_avg_sum = 0;
@@ -1791,6 +1887,9 @@ void sched_fork(struct task_struct *p)
 	if (likely(sched_info_on()))
 		memset(&p->sched_info, 0, sizeof(p->sched_info));
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	p->sched_lat_queued = 0;
+#endif
 #if defined(CONFIG_SMP)
 	p->on_cpu = 0;
 #endif
@@ -1914,6 +2013,7 @@ prepare_task_switch(struct rq *rq, struct task_struct *prev,
 {
 	trace_sched_switch(prev, next);
 	sched_info_switch(prev, next);
+	sched_lat_switch(rq, prev, next);
 	perf_event_task_sched_out(prev, next);
 	fire_sched_out_preempt_notifiers(prev, next);
 	prepare_lock_switch(rq, next);
@@ -7039,6 +7139,9 @@ int in_sched_functions(unsigned long addr)
  */
 struct task_group root_task_group;
 LIST_HEAD(task_groups);
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static DEFINE_PER_CPU(struct sched_lat_hist, root_task_group_lat_hist);
+#endif
 #endif
 
 DECLARE_PER_CPU(cpumask_var_t, load_balance_mask);
@@ -7103,6 +7206,10 @@ void __init sched_init(void)
 	list_add(&root_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&root_task_group.children);
 	INIT_LIST_HEAD(&root_task_group.siblings);
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	/* too early for alloc_percpu() */
+	root_task_group.lat_hist = &root_task_group_lat_hist;
+#endif
 	autogroup_init(&init_task);
 
 #endif /* CONFIG_CGROUP_SCHED */
@@ -7391,6 +7498,9 @@ static void free_sched_group(struct task_group *tg)
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
 	autogroup_free(tg);
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	free_percpu(tg->lat_hist);
+#endif
 	kfree(tg);
 }
 
@@ -7409,6 +7519,12 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	tg->lat_hist = alloc_percpu(struct sched_lat_hist);
+	if (!tg->lat_hist)
+		goto err;
+#endif
+
 	return tg;
 
 err:
@@ -8167,6 +8283,35 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static int cpu_sched_latency_show(struct cgroup *cgrp, struct cftype *cft,
+				  struct seq_file *m)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	struct sched_lat_hist sum;
+	int cpu;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu)
+		sched_lat_hist_add(&sum, per_cpu_ptr(tg->lat_hist, cpu));
+	sched_lat_hist_show(m, "", &sum);
+
+	return 0;
+}
+
+static int cpu_sched_latency_reset(struct cgroup *cgrp, unsigned int event)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(tg->lat_hist, cpu), 0,
+		       sizeof(struct sched_lat_hist));
+
+	return 0;
+}
+#endif /* CONFIG_SCHED_LATENCY_HIST */
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -8202,6 +8347,13 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_rt_period_read_uint,
 		.write_u64 = cpu_rt_period_write_uint,
 	},
+#endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	{
+		.name = "sched_latency",
+		.read_seq_string = cpu_sched_latency_show,
+		.trigger = cpu_sched_latency_reset,
+	},
 #endif
 	{ }	/* terminate */
 };
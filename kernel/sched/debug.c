@@ -564,6 +564,13 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 		__PN(avg_atom);
 		__PN(avg_per_cpu);
 	}
+#endif
+#ifdef CONFIG_SCHED_HMP
+	P(se.avg.hmp_nr_up_migrations);
+	P(se.avg.hmp_nr_down_migrations);
+	P(se.avg.hmp_nr_skipped_migrations);
+	PN(se.avg.hmp_residency);
+	PN(se.avg.hmp_migration_cost);
 #endif
 	__P(nr_switches);
 	SEQ_printf(m, "%-35s:%21Ld\n",
@@ -595,4 +602,10 @@ void proc_sched_set_task(struct task_struct *p)
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
+#ifdef CONFIG_SCHED_HMP
+	p->se.avg.hmp_nr_up_migrations = 0;
+	p->se.avg.hmp_nr_down_migrations = 0;
+	p->se.avg.hmp_nr_skipped_migrations = 0;
+	p->se.avg.hmp_migration_cost = 0;
+#endif
 }
@@ -29,6 +29,9 @@
 #include <linux/mempolicy.h>
 #include <linux/migrate.h>
 #include <linux/task_work.h>
+#ifdef CONFIG_CPU_FREQ_GOV_SCHED
+#include <linux/cpufreq.h>
+#endif
 
 #include <trace/events/sched.h>
 #ifdef CONFIG_HMP_VARIABLE_SCALE
@@ -1228,9 +1231,9 @@ struct hmp_global_attr {
 };
 
 #ifdef CONFIG_HMP_FREQUENCY_INVARIANT_SCALE
-#define HMP_DATA_SYSFS_MAX 21
+#define HMP_DATA_SYSFS_MAX 23
 #else
-#define HMP_DATA_SYSFS_MAX 20
+#define HMP_DATA_SYSFS_MAX 22
 #endif
 
 struct hmp_data_struct {
@@ -1593,6 +1596,12 @@ unsigned int hmp_semiboost_down_threshold = 150;
 /* Global switch between power-aware migrations and classical GTS. */
 unsigned int hmp_power_migration = 1;
 
+/* Consult the per-cluster energy model for up/down migrations. */
+unsigned int hmp_energy_aware = 1;
+
+/* Skip migrations reversing the last one unless they pay for their cost. */
+unsigned int hmp_migration_cost_aware = 1;
+
 /* Performance threshold for guaranteeing an up migration. */
 unsigned int hmp_up_perf_threshold = 597;
 
@@ -1748,6 +1757,23 @@ static inline unsigned int hmp_cpu_is_fastest(int cpu);
 static inline unsigned int hmp_cpu_is_slowest(int cpu);
 static inline struct hmp_domain *hmp_slower_domain(int cpu);
 static inline struct hmp_domain *hmp_faster_domain(int cpu);
+
+/* index into cpu_efficiency_table: 0 little, 1 big */
+static inline int hmp_cpu_cluster(int cpu)
+{
+	return hmp_cpu_is_fastest(cpu) ? 1 : 0;
+}
+
+static void hmp_migration_latency_update(struct sched_entity *se, int cpu);
+
+/* has se run recently enough that its working set is still cached? */
+static inline int hmp_task_cache_hot(struct sched_entity *se)
+{
+	struct rq *rq = se->cfs_rq->rq;
+
+	return (s64)(rq->clock_task - se->exec_start) <
+		(s64)sysctl_sched_migration_cost;
+}
 #endif
 
 static inline void __update_task_entity_contrib(struct sched_entity *se)
@@ -1878,6 +1904,28 @@ static inline void update_rq_runnable_avg(struct rq *rq, int runnable)
 	trace_sched_rq_runnable_load(cpu_of(rq), rq->cfs.runnable_load_avg);
 }
 
+#ifdef CONFIG_CPU_FREQ_GOV_SCHED
+/*
+ * Report the utilization of rq to the sched cpufreq governor. The rq
+ * runnable average decays slowly and holds the frequency across short
+ * sleeps, while the sum of the queued tasks' ratios moves at once when
+ * a heavy task wakes up or is migrated in.
+ */
+static inline void update_cpufreq_sched(struct rq *rq)
+{
+	unsigned long util, ratio;
+
+	util = div_u64((u64)rq->avg.runnable_avg_sum << SCHED_POWER_SHIFT,
+		       rq->avg.runnable_avg_period + 1);
+	ratio = scale_load_down(rq->avg.load_avg_ratio);
+	util = max(util, min(ratio, (unsigned long)SCHED_POWER_SCALE));
+
+	cpufreq_sched_update_util(cpu_of(rq), util);
+}
+#else
+static inline void update_cpufreq_sched(struct rq *rq) { }
+#endif
+
 /* Add the load generated by se into cfs_rq's child load-average */
 static inline void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
 						  struct sched_entity *se,
@@ -1969,6 +2017,7 @@ void idle_exit_fair(struct rq *this_rq)
 static inline void update_entity_load_avg(struct sched_entity *se,
 					  int update_cfs_rq) {}
 static inline void update_rq_runnable_avg(struct rq *rq, int runnable) {}
+static inline void update_cpufreq_sched(struct rq *rq) {}
 static inline void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
 					   struct sched_entity *se,
 					   int wakeup) {}
@@ -2285,6 +2334,10 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 
 	update_stats_curr_start(cfs_rq, se);
 	cfs_rq->curr = se;
+#ifdef CONFIG_SCHED_HMP
+	if (unlikely(se->avg.hmp_migrate_start) && entity_is_task(se))
+		hmp_migration_latency_update(se, cpu_of(rq_of(cfs_rq)));
+#endif
 #ifdef CONFIG_SCHEDSTATS
 	/*
 	 * Track our maximum slice length, if the CPU's load is at
@@ -3239,6 +3292,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		update_rq_runnable_avg(rq, rq->nr_running);
 		inc_nr_running(rq);
 	}
+	update_cpufreq_sched(rq);
 	hrtick_update(rq);
 }
 
@@ -3300,6 +3354,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		dec_nr_running(rq);
 		update_rq_runnable_avg(rq, 1);
 	}
+	update_cpufreq_sched(rq);
 	hrtick_update(rq);
 }
 
@@ -3780,11 +3835,24 @@ static void hmp_offline_cpu(int cpu)
 
 /* must hold runqueue lock for queue se is currently on */
 
+/*
+ * A task whose cache went cold is cheaper to move, so with cost aware
+ * migration it competes with 1/8 extra ratio against hot ones.
+ */
+static inline unsigned long hmp_migrate_ratio(struct sched_entity *se)
+{
+	unsigned long ratio = se->avg.load_avg_ratio;
+
+	if (hmp_migration_cost_aware && !hmp_task_cache_hot(se))
+		ratio += ratio >> 3;
+	return ratio;
+}
+
 static struct sched_entity *hmp_get_heaviest_task(struct sched_entity* se, int migrate_up)
 {
 	int num_tasks = hmp_max_tasks;
 	struct sched_entity *max_se = se;
-	unsigned long int max_ratio = se->avg.load_avg_ratio;
+	unsigned long int max_ratio = hmp_migrate_ratio(se);
 	const struct cpumask *hmp_target_mask = NULL;
 
 	if (migrate_up) {
@@ -3801,12 +3869,12 @@ static struct sched_entity *hmp_get_heaviest_task(struct sched_entity* se, int m
 
 	while(num_tasks && se) {
 		if (entity_is_task(se)) {
-			if(se->avg.load_avg_ratio > max_ratio &&
+			if(hmp_migrate_ratio(se) > max_ratio &&
 					(hmp_target_mask &&
 					 cpumask_intersects(hmp_target_mask,
 						 tsk_cpus_allowed(task_of(se))))) {
 				max_se = se;
-				max_ratio = se->avg.load_avg_ratio;
+				max_ratio = hmp_migrate_ratio(se);
 			}
 		}
 		se = __pick_next_entity(se);
@@ -4041,10 +4109,70 @@ static inline unsigned int hmp_best_little_cpu(struct task_struct *tsk,
 	return cpu;
 }
 #endif
+/*
+ * Migration cost accounting.
+ *
+ * The cost of moving a task to another cluster is the measured delay
+ * from the migration decision until the task runs at the destination
+ * (an EWMA per destination cluster) plus, if the task ran recently
+ * enough for its working set to still sit in the source cluster's L2,
+ * sysctl_sched_migration_cost for refilling it at the destination.
+ * hmp_residency tracks how much the task runs between two HMP
+ * migrations, which is the time a migration has to pay for itself in.
+ */
+static u64 hmp_migration_latency[2];
+
+static void hmp_migration_latency_update(struct sched_entity *se, int cpu)
+{
+	u64 *lat = &hmp_migration_latency[hmp_cpu_cluster(cpu)];
+	s64 delta = local_clock() - se->avg.hmp_migrate_start;
+
+	se->avg.hmp_migrate_start = 0;
+	if (delta <= 0)
+		return;
+
+	/* 1/8 weight, racy updates from several CPUs are harmless */
+	*lat = *lat - (*lat >> 3) + ((u64)delta >> 3);
+}
+
+static u64 hmp_migration_cost_ns(struct sched_entity *se, int dst_cpu)
+{
+	struct rq *src_rq = cpu_rq(task_cpu(task_of(se)));
+	u64 cost = hmp_migration_latency[hmp_cpu_cluster(dst_cpu)];
+
+	if ((s64)(src_rq->clock_task - se->exec_start) <
+			(s64)sysctl_sched_migration_cost)
+		cost += sysctl_sched_migration_cost;
+
+	return cost;
+}
+
+static inline void hmp_account_migration(struct sched_entity *se, int cpu,
+					 int up)
+{
+	struct sched_avg *avg = &se->avg;
+	u64 runtime = se->sum_exec_runtime - avg->hmp_last_runtime;
+
+	if (avg->hmp_nr_up_migrations || avg->hmp_nr_down_migrations)
+		avg->hmp_residency = avg->hmp_residency -
+			(avg->hmp_residency >> 2) + (runtime >> 2);
+	else
+		avg->hmp_residency = runtime;
+	avg->hmp_last_runtime = se->sum_exec_runtime;
+
+	avg->hmp_migration_cost += hmp_migration_cost_ns(se, cpu);
+	avg->hmp_migrate_start = local_clock();
+	if (up)
+		avg->hmp_nr_up_migrations++;
+	else
+		avg->hmp_nr_down_migrations++;
+}
+
 static inline void hmp_next_up_delay(struct sched_entity *se, int cpu)
 {
 	/* hack - always use clock from first online CPU */
 	u64 now = cpu_rq(cpumask_first(cpu_online_mask))->clock_task;
+	hmp_account_migration(se, cpu, 1);
 	se->avg.hmp_last_up_migration = now;
 	se->avg.hmp_last_down_migration = 0;
 	cpu_rq(cpu)->avg.hmp_last_up_migration = now;
@@ -4055,12 +4183,44 @@ static inline void hmp_next_down_delay(struct sched_entity *se, int cpu)
 {
 	/* hack - always use clock from first online CPU */
 	u64 now = cpu_rq(cpumask_first(cpu_online_mask))->clock_task;
+	hmp_account_migration(se, cpu, 0);
 	se->avg.hmp_last_down_migration = now;
 	se->avg.hmp_last_up_migration = 0;
 	cpu_rq(cpu)->avg.hmp_last_down_migration = now;
 	cpu_rq(cpu)->avg.hmp_last_up_migration = 0;
 }
 
+/*
+ * A migration that undoes the task's previous one has to win back its
+ * cost within the task's expected residency: moving up saves the
+ * capacity difference of that runtime, moving down needs the task to
+ * stay down for at least the cost. First moves and moves in the same
+ * direction as the last one are not second guessed.
+ */
+static int hmp_migration_pays_off(struct sched_entity *se, int src_cpu,
+				  int dst_cpu, int up)
+{
+	struct sched_avg *avg = &se->avg;
+	unsigned long src_cap, dst_cap;
+	u64 benefit;
+
+	if (!hmp_migration_cost_aware || !avg->hmp_residency)
+		return 1;
+	if (up ? !avg->hmp_last_down_migration : !avg->hmp_last_up_migration)
+		return 1;
+
+	benefit = avg->hmp_residency;
+	if (up) {
+		src_cap = hmp_cpu_cluster(src_cpu) ? fast_cap_max : slow_cap_max;
+		dst_cap = hmp_cpu_cluster(dst_cpu) ? fast_cap_max : slow_cap_max;
+		if (dst_cap <= src_cap)
+			return 1;
+		benefit = div64_u64(benefit * (dst_cap - src_cap), dst_cap);
+	}
+
+	return benefit >= hmp_migration_cost_ns(se, dst_cpu);
+}
+
 #ifdef CONFIG_HMP_VARIABLE_SCALE
 /*
  * Heterogenous multiprocessor (HMP) optimizations
@@ -4174,6 +4334,20 @@ static int hmp_power_migration_from_sysfs(int value)
 	return 0;
 }
 
+static int hmp_energy_aware_from_sysfs(int value)
+{
+	hmp_energy_aware = !!value;
+
+	return 0;
+}
+
+static int hmp_migration_cost_aware_from_sysfs(int value)
+{
+	hmp_migration_cost_aware = !!value;
+
+	return 0;
+}
+
 /* max value for threshold is 1024 */
 static int hmp_up_threshold_from_sysfs(int value)
 {
@@ -4523,6 +4697,14 @@ static int hmp_attr_init(void)
 		&hmp_power_migration,
 		NULL,
 		hmp_power_migration_from_sysfs);
+	hmp_attr_add("energy_aware",
+		&hmp_energy_aware,
+		NULL,
+		hmp_energy_aware_from_sysfs);
+	hmp_attr_add("migration_cost_aware",
+		&hmp_migration_cost_aware,
+		NULL,
+		hmp_migration_cost_aware_from_sysfs);
 	hmp_attr_add("up_threshold",
 		&hmp_up_threshold,
 		NULL,
@@ -7245,6 +7427,167 @@ static void nohz_idle_balance(int this_cpu, enum cpu_idle_type idle) { }
 #endif
 
 #ifdef CONFIG_SCHED_HMP
+/*
+ * Energy model for HMP placement.
+ *
+ * cpu_efficiency_table holds, per cluster, the capacity (MHz * arch
+ * efficiency) and the power of one busy core (IPA coefficients) at each
+ * OPP. The demand of a CPU is its runnable ratio times the capacity that
+ * ratio refers to. A cluster runs at the lowest OPP that leaves 20%
+ * headroom over its busiest CPU, and each CPU then burns that OPP's power
+ * for the fraction of time it is busy, so the cluster costs
+ * power(opp) * sum(demand) / capacity(opp). Idle and cluster-wide power
+ * are not modelled.
+ */
+#define HMP_ENERGY_INFEASIBLE	(~0ULL)
+
+static inline int hmp_energy_model_ready(void)
+{
+	return hmp_energy_aware &&
+		cpu_efficiency_table[0].n_p_states &&
+		cpu_efficiency_table[1].n_p_states;
+}
+
+/*
+ * Capacity a runnable ratio of 1024 stands for. Exact with frequency
+ * invariant load tracking; without it the ratio is relative to the
+ * current OPP and the highest one is an upper bound.
+ */
+static inline unsigned long hmp_cpu_ref_cap(int cpu)
+{
+	return hmp_cpu_cluster(cpu) ? fast_cap_max : slow_cap_max;
+}
+
+static inline unsigned long hmp_cpu_util(int cpu)
+{
+	struct sched_avg *avg = &cpu_rq(cpu)->avg;
+
+	return div_u64((u64)avg->runnable_avg_sum << SCHED_POWER_SHIFT,
+		       avg->runnable_avg_period + 1);
+}
+
+static u64 hmp_cluster_energy(int cl, unsigned long max_demand,
+			      unsigned long sum_demand)
+{
+	struct cpu_cluster_efficiency *ce = &cpu_efficiency_table[cl];
+	struct cpu_p_state *ps, *opp = NULL;
+	unsigned long need = max_demand + (max_demand >> 2);
+	int i;
+
+	for (i = 0; i < ce->n_p_states; i++) {
+		ps = &ce->p_states[i];
+		if (ps->capacity < need)
+			continue;
+		if (!opp || ps->capacity < opp->capacity)
+			opp = ps;
+	}
+
+	if (!opp)
+		return HMP_ENERGY_INFEASIBLE;
+
+	return div_u64((u64)opp->power * sum_demand, opp->capacity);
+}
+
+/*
+ * Energy of the hmp domain, optionally with @task worth of demand
+ * taken off @sub_cpu and put on @add_cpu (-1 for none).
+ */
+static u64 hmp_domain_energy(struct hmp_domain *hmpd, int add_cpu,
+			     int sub_cpu, unsigned long task)
+{
+	unsigned long demand, max_demand = 0, sum_demand = 0;
+	unsigned long ref_cap = 0;
+	int cpu, cl = -1;
+
+	for_each_cpu_and(cpu, &hmpd->cpus, cpu_online_mask) {
+		if (cl < 0) {
+			cl = hmp_cpu_cluster(cpu);
+			ref_cap = hmp_cpu_ref_cap(cpu);
+		}
+		demand = (hmp_cpu_util(cpu) * ref_cap) >> SCHED_POWER_SHIFT;
+		if (cpu == sub_cpu)
+			demand -= min(demand, task);
+		if (cpu == add_cpu)
+			demand += task;
+
+		max_demand = max(max_demand, demand);
+		sum_demand += demand;
+	}
+
+	/* the whole cluster is hotplugged out */
+	if (cl < 0)
+		return 0;
+
+	return hmp_cluster_energy(cl, max_demand, sum_demand);
+}
+
+/*
+ * Would moving se from src_cpu to dst_cpu save more than hysteresis
+ * (in SCHED_LOAD_SCALE units) of the estimated power of both clusters?
+ * A move off a cluster that cannot serve its demand always saves, a
+ * move onto one that cannot serve the task never does.
+ */
+static int hmp_energy_saves(struct sched_entity *se, int src_cpu,
+			    int dst_cpu, unsigned int hysteresis)
+{
+	struct hmp_domain *src_d = hmp_cpu_domain(src_cpu);
+	struct hmp_domain *dst_d = hmp_cpu_domain(dst_cpu);
+	unsigned long task;
+	u64 src_before, dst_before, src_after, dst_after;
+
+	task = (scale_load_down(se->avg.load_avg_ratio) *
+		hmp_cpu_ref_cap(src_cpu)) >> SCHED_POWER_SHIFT;
+
+	dst_after = hmp_domain_energy(dst_d, dst_cpu, -1, task);
+	if (dst_after == HMP_ENERGY_INFEASIBLE)
+		return 0;
+
+	/* sub then add makes sure the task counts even after a long sleep */
+	src_before = hmp_domain_energy(src_d, src_cpu, src_cpu, task);
+	if (src_before == HMP_ENERGY_INFEASIBLE)
+		return 1;
+
+	src_after = hmp_domain_energy(src_d, -1, src_cpu, task);
+	dst_before = hmp_domain_energy(dst_d, -1, -1, 0);
+
+	hysteresis = min_t(unsigned int, hysteresis, SCHED_LOAD_SCALE);
+
+	return (src_after + dst_after) * SCHED_LOAD_SCALE <
+		(src_before + dst_before) * (SCHED_LOAD_SCALE - hysteresis);
+}
+
+static unsigned int hmp_energy_up(int cpu, struct sched_entity *se)
+{
+	int dst_cpu;
+
+	hmp_domain_min_load(hmp_faster_domain(cpu), &dst_cpu,
+			tsk_cpus_allowed(task_of(se)));
+	if (dst_cpu >= NR_CPUS)
+		return 0;
+
+	return hmp_energy_saves(se, cpu, dst_cpu, hmp_up_perf_hysteresis);
+}
+
+static unsigned int hmp_energy_down(int cpu, struct sched_entity *se,
+				    unsigned int up_threshold)
+{
+	unsigned long task, ratio;
+	int dst_cpu;
+
+	dst_cpu = hmp_select_slower_cpu(task_of(se), cpu);
+	if (dst_cpu >= NR_CPUS)
+		return 0;
+
+	/* don't move down what the up threshold would send straight back */
+	task = (scale_load_down(se->avg.load_avg_ratio) *
+		hmp_cpu_ref_cap(cpu)) >> SCHED_POWER_SHIFT;
+	ratio = (task << SCHED_POWER_SHIFT) / hmp_cpu_ref_cap(dst_cpu);
+	if (ratio >= up_threshold)
+		return 0;
+
+	return hmp_energy_saves(se, cpu, dst_cpu, hmp_down_perf_hysteresis);
+}
+
 /* Check if task should migrate to a faster cpu */
 static unsigned int hmp_up_migration(int cpu, int *target_cpu, struct sched_entity *se)
 {
@@ -7269,7 +7612,10 @@ static unsigned int hmp_up_migration(int cpu, int *target_cpu, struct sched_enti
 			up_threshold = hmp_power_migration ? hmp_up_perf_threshold : hmp_up_threshold;
 
 		if (se->avg.load_avg_ratio < up_threshold) {
-			if (hmp_power_migration) {
+			if (hmp_energy_model_ready()) {
+				if (!hmp_energy_up(cpu, se))
+					return 0;
+			} else if (hmp_power_migration) {
 				if (!((se->avg.load_avg_ratio > hmp_up_power_threshold) 
 				    && is_efficient_up(se->avg.load_avg_ratio)))
 					return 0;
@@ -7293,21 +7639,20 @@ static unsigned int hmp_up_migration(int cpu, int *target_cpu, struct sched_enti
 	min_load = hmp_domain_min_load(hmp_faster_domain(cpu),
 			&temp_target_cpu, tsk_cpus_allowed(p));
 
-	if (temp_target_cpu != NR_CPUS) {
-		if (hmp_aggressive_up_migration) {
-			if (target_cpu)
-				*target_cpu = temp_target_cpu;
-			return 1;
-		} else {
-			if (min_load == 0) {
-				if (target_cpu)
-					*target_cpu = temp_target_cpu;
-				return 1;
-			}
-		}
+	if (temp_target_cpu == NR_CPUS ||
+	    (!hmp_aggressive_up_migration && min_load))
+		return 0;
+
+	/* the only veto left, count the moves it actually stops */
+	if (!hmp_boost() &&
+	    !hmp_migration_pays_off(se, cpu, temp_target_cpu, 1)) {
+		se->avg.hmp_nr_skipped_migrations++;
+		return 0;
 	}
 
-	return 0;
+	if (target_cpu)
+		*target_cpu = temp_target_cpu;
+	return 1;
 }
 
 /* Check if task should migrate to a slower cpu */
@@ -7354,18 +7699,35 @@ static unsigned int hmp_down_migration(int cpu, struct sched_entity *se)
 
 	if (cpumask_intersects(&hmp_slower_domain(cpu)->cpus,
 					tsk_cpus_allowed(p))) {
-		unsigned int down_threshold;
+		unsigned int down_threshold, up_threshold;
+		int migrate = 0;
 
-		if (hmp_semiboost())
+		if (hmp_semiboost()) {
 			down_threshold = hmp_semiboost_down_threshold;
-		else
+			up_threshold = hmp_semiboost_up_threshold;
+		} else {
 			down_threshold = hmp_down_threshold;
+			up_threshold = hmp_power_migration ? hmp_up_perf_threshold : hmp_up_threshold;
+		}
 		
-		if (hmp_power_migration && is_efficient_down(se->avg.load_avg_ratio))
-			return 1;
+		if (hmp_energy_model_ready())
+			migrate = hmp_energy_down(cpu, se, up_threshold);
+		else if (hmp_power_migration)
+			migrate = is_efficient_down(se->avg.load_avg_ratio);
 
 		if (!hmp_power_migration && se->avg.load_avg_ratio < down_threshold)
-			return 1;
+			migrate = 1;
+
+		if (!migrate)
+			return 0;
+
+		/* the only veto left, count the moves it actually stops */
+		if (!hmp_migration_pays_off(se, cpu,
+				cpumask_first(&hmp_slower_domain(cpu)->cpus), 0)) {
+			se->avg.hmp_nr_skipped_migrations++;
+			return 0;
+		}
+		return 1;
 	}
 	return 0;
 }
@@ -7881,6 +8243,7 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		task_tick_numa(rq, curr);
 
 	update_rq_runnable_avg(rq, 1);
+	update_cpufreq_sched(rq);
 }
 
 /*
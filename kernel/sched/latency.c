@@ -0,0 +1,123 @@
+/*
+ * Scheduler latency histograms.
+ *
+ * Every CPU keeps a log2 histogram of the time tasks spent runnable before
+ * they got to run on it, in struct rq, and every cpu cgroup keeps a per-CPU
+ * copy of the same for its own tasks (see sched_lat_arrive() in core.c).
+ * This file only formats them: /proc/schedlat shows the per-CPU histograms,
+ * the cgroup side is cpu.sched_latency. Writing anything to either file
+ * clears the histograms behind it.
+ */
+
+#include <linux/fs.h>
+#include <linux/seq_file.h>
+#include <linux/proc_fs.h>
+
+#include "sched.h"
+
+/*
+ * bump this up when changing the output format or the meaning of an existing
+ * format, so that tools can adapt (or abort)
+ */
+#define SCHEDLAT_VERSION 1
+
+static const char * const sched_lat_type_name[SCHED_LAT_NR_TYPES] = {
+	[SCHED_LAT_WAKEUP]	= "wakeup",
+	[SCHED_LAT_WAIT]	= "wait",
+};
+
+void sched_lat_hist_add(struct sched_lat_hist *dst,
+			const struct sched_lat_hist *src)
+{
+	int t, i;
+
+	for (t = 0; t < SCHED_LAT_NR_TYPES; t++) {
+		for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+			dst->bucket[t][i] += src->bucket[t][i];
+		dst->sum[t] += src->sum[t];
+		dst->max[t] = max(dst->max[t], src->max[t]);
+	}
+}
+
+/*
+ * One line per histogram type:
+ *	<prefix><type> <count> <sum ns> <max ns> <bucket 0> ... <bucket N-1>
+ */
+void sched_lat_hist_show(struct seq_file *m, const char *prefix,
+			 const struct sched_lat_hist *h)
+{
+	unsigned long count;
+	int t, i;
+
+	for (t = 0; t < SCHED_LAT_NR_TYPES; t++) {
+		count = 0;
+		for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+			count += h->bucket[t][i];
+
+		seq_printf(m, "%s%s %lu %llu %llu", prefix,
+			   sched_lat_type_name[t], count,
+			   (unsigned long long)h->sum[t],
+			   (unsigned long long)h->max[t]);
+		for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+			seq_printf(m, " %lu", h->bucket[t][i]);
+		seq_putc(m, '\n');
+	}
+}
+
+static int schedlat_show(struct seq_file *m, void *v)
+{
+	char prefix[16];
+	int cpu, i;
+
+	seq_printf(m, "version %d\n", SCHEDLAT_VERSION);
+	seq_printf(m, "timestamp %lu\n", jiffies);
+
+	/* lower bound of each bucket in us */
+	seq_puts(m, "buckets 0");
+	for (i = 1; i < SCHED_LAT_BUCKETS; i++)
+		seq_printf(m, " %lu", 1UL << (i - 1));
+	seq_putc(m, '\n');
+
+	for_each_online_cpu(cpu) {
+		snprintf(prefix, sizeof(prefix), "cpu%d ", cpu);
+		sched_lat_hist_show(m, prefix, &cpu_rq(cpu)->lat_hist);
+	}
+
+	return 0;
+}
+
+static int schedlat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, schedlat_show, NULL);
+}
+
+/*
+ * The owning CPUs keep updating while we clear, so a reset is only as exact
+ * as a statistic needs to be.
+ */
+static ssize_t schedlat_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&cpu_rq(cpu)->lat_hist, 0, sizeof(struct sched_lat_hist));
+
+	return count;
+}
+
+static const struct file_operations proc_schedlat_operations = {
+	.open    = schedlat_open,
+	.read    = seq_read,
+	.write   = schedlat_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static int __init proc_schedlat_init(void)
+{
+	proc_create("schedlat", S_IRUGO | S_IWUSR, NULL,
+		    &proc_schedlat_operations);
+	return 0;
+}
+module_init(proc_schedlat_init);
@@ -102,6 +102,33 @@ struct rt_bandwidth {
 
 extern struct mutex sched_domains_mutex;
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/*
+ * log2 histogram of the time tasks spend runnable but not running. Bucket 0
+ * counts waits below 1us (1024ns), bucket i waits in [2^(i-1), 2^i) us and the
+ * last bucket everything longer. Each CPU only updates its own copy, with its
+ * rq lock held, so readers just sum the copies without any locking.
+ */
+#define SCHED_LAT_BUCKETS	22
+
+enum {
+	SCHED_LAT_WAKEUP,	/* from wakeup to first run */
+	SCHED_LAT_WAIT,		/* any runqueue wait, wakeups included */
+	SCHED_LAT_NR_TYPES,
+};
+
+struct sched_lat_hist {
+	unsigned long bucket[SCHED_LAT_NR_TYPES][SCHED_LAT_BUCKETS];
+	u64 sum[SCHED_LAT_NR_TYPES];
+	u64 max[SCHED_LAT_NR_TYPES];
+};
+
+extern void sched_lat_hist_add(struct sched_lat_hist *dst,
+			       const struct sched_lat_hist *src);
+extern void sched_lat_hist_show(struct seq_file *m, const char *prefix,
+				const struct sched_lat_hist *h);
+#endif
+
 #ifdef CONFIG_CGROUP_SCHED
 
 #include <linux/cgroup.h>
@@ -163,6 +190,10 @@ struct task_group {
 	struct autogroup *autogroup;
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	struct sched_lat_hist __percpu *lat_hist;
+#endif
+
 	struct cfs_bandwidth cfs_bandwidth;
 };
 
@@ -524,6 +555,10 @@ struct rq {
 	unsigned int ttwu_local;
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	struct sched_lat_hist lat_hist;
+#endif
+
 #ifdef CONFIG_SMP
 	struct llist_head wake_list;
 #endif
@@ -0,0 +1,497 @@
+/*
+ * iosched-bench - compare I/O schedulers by replaying a block workload
+ *
+ * For every scheduler given with -s the tool selects it through
+ * /sys/block/<dev>/queue/scheduler, replays the same workload and reports
+ * read / write latency percentiles, throughput and fairness.
+ *
+ * The workload is either a text blktrace capture (the default output of
+ * "blkparse -i <trace>", only 'Q' events are used) or one of the built-in
+ * synthetic profiles: applaunch, camera, bgsync. Requests of one traced
+ * process are issued in order by one thread at their recorded time offsets,
+ * so sync readers keep their dependency on each other while different
+ * processes compete for the device like on the phone.
+ *
+ * It is meant to run against /dev/iosim0 (CONFIG_BLK_DEV_IOSIM), whose
+ * device model is set through /sys/module/iosim/parameters, but any scratch
+ * block device works. Writes destroy the data on the target device.
+ *
+ * Fairness is Jain's index over the mean latency of every stream:
+ * 1.0 means all streams saw the same latency, 1/n means one stream got all
+ * the service.
+ *
+ * Reads and sync writes use O_DIRECT. Async writes go through a second,
+ * buffered descriptor so they reach the scheduler from writeback like on
+ * the phone, and their latency is the page cache copy. Each run ends
+ * with an fsync() of that descriptor so the writeback counts in MB/s.
+ *
+ * Usage: iosched-bench -d iosim0 [-s row,sioplus,cfq,...] [-t trace.txt |
+ *			-w applaunch|camera|bgsync] [-r runs] [-l max_streams]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#define MAX_STREAMS	64
+#define MAX_IO_BYTES	(1024 * 1024)
+#define SECTOR_SIZE	512
+
+#define DEFAULT_SCHEDS	"row,sioplus,tripndroid,bfq,cfq,deadline,noop"
+
+struct io_event {
+	uint64_t time_ns;	/* offset from the start of the workload */
+	uint64_t sector;
+	uint32_t bytes;
+	int write;
+	int sync;
+	uint64_t lat_ns;	/* measured */
+};
+
+struct stream {
+	int pid;
+	struct io_event *ev;
+	int nr, alloc;
+	pthread_t thread;
+};
+
+static struct stream streams[MAX_STREAMS];
+static int nr_streams;
+static int max_streams = MAX_STREAMS;
+
+static const char *dev_name;
+static int dev_fd = -1;		/* O_DIRECT */
+static int buf_fd = -1;		/* buffered, for async writes */
+static uint64_t dev_sectors;
+static struct timespec start_ts;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t ts_ns(struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ull + ts->tv_nsec;
+}
+
+static struct stream *get_stream(int pid)
+{
+	struct stream *s;
+	int i;
+
+	for (i = 0; i < nr_streams; i++)
+		if (streams[i].pid == pid)
+			return &streams[i];
+
+	/* fold processes beyond the limit into existing streams */
+	if (nr_streams == max_streams)
+		return &streams[pid % max_streams];
+
+	s = &streams[nr_streams++];
+	s->pid = pid;
+	return s;
+}
+
+static void add_event(int pid, uint64_t time_ns, uint64_t sector,
+		      uint32_t bytes, int write, int sync)
+{
+	struct stream *s = get_stream(pid);
+	struct io_event *ev;
+
+	if (!bytes || bytes > MAX_IO_BYTES)
+		return;
+
+	if (s->nr == s->alloc) {
+		s->alloc = s->alloc ? s->alloc * 2 : 256;
+		s->ev = realloc(s->ev, s->alloc * sizeof(*s->ev));
+		if (!s->ev) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	ev = &s->ev[s->nr++];
+	memset(ev, 0, sizeof(*ev));
+	ev->time_ns = time_ns;
+	ev->sector = sector;
+	ev->bytes = bytes;
+	ev->write = write;
+	ev->sync = sync;
+}
+
+/*
+ * Default blkparse output:
+ *   8,0    3        1     0.000000000   697  Q   R 223490 + 8 [kjournald]
+ */
+static int load_trace(const char *path)
+{
+	char line[512], action[8], rwbs[16];
+	unsigned int maj, min, cpu, seq, nsect;
+	unsigned long long sector;
+	double t;
+	int pid, n = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%u,%u %u %u %lf %d %7s %15s %llu + %u",
+			   &maj, &min, &cpu, &seq, &t, &pid, action, rwbs,
+			   &sector, &nsect) != 10)
+			continue;
+		if (strcmp(action, "Q"))
+			continue;
+		if (!strchr(rwbs, 'R') && !strchr(rwbs, 'W'))
+			continue;
+
+		add_event(pid, (uint64_t)(t * 1e9), sector,
+			  nsect * SECTOR_SIZE, !!strchr(rwbs, 'W'),
+			  !!strchr(rwbs, 'S') || !strchr(rwbs, 'W'));
+		n++;
+	}
+	fclose(f);
+
+	if (!n) {
+		fprintf(stderr, "%s: no queue events found\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+static uint64_t rnd_sector(unsigned int *seed, uint32_t bytes)
+{
+	uint64_t span = dev_sectors - bytes / SECTOR_SIZE;
+	uint64_t r = ((uint64_t)rand_r(seed) << 31) | rand_r(seed);
+
+	/* keep requests 4KB aligned */
+	return (r % span) & ~7ull;
+}
+
+/*
+ * Synthetic profiles, all 2 seconds long:
+ *  applaunch - 4 processes doing dependent 4-16KB random sync reads while
+ *              one writer streams 128KB async writes in the background
+ *  camera    - one burst writer of 512KB sequential writes, two random
+ *              sync readers (gallery thumbnails, UI)
+ *  bgsync    - two sequential async writers and one random sync reader
+ */
+static int gen_workload(const char *name)
+{
+	unsigned int seed = 1;
+	uint64_t t, seq;
+	int p;
+
+	if (!strcmp(name, "applaunch")) {
+		for (p = 0; p < 4; p++)
+			for (t = 0; t < 2000000000ull; t += 250000)
+				add_event(100 + p, t, rnd_sector(&seed, 16384),
+					  4096 << (rand_r(&seed) % 3), 0, 1);
+		for (t = 0, seq = 0; t < 2000000000ull; t += 2000000, seq += 256)
+			add_event(200, t, seq, 131072, 1, 0);
+	} else if (!strcmp(name, "camera")) {
+		for (t = 0, seq = 0; t < 2000000000ull; t += 5000000, seq += 1024)
+			add_event(100, t, seq, 524288, 1, 0);
+		for (p = 0; p < 2; p++)
+			for (t = 0; t < 2000000000ull; t += 1000000)
+				add_event(200 + p, t, rnd_sector(&seed, 4096),
+					  4096, 0, 1);
+	} else if (!strcmp(name, "bgsync")) {
+		for (p = 0; p < 2; p++)
+			for (t = 0, seq = p * (dev_sectors / 2);
+			     t < 2000000000ull; t += 1000000, seq += 128)
+				add_event(100 + p, t, seq, 65536, 1, 0);
+		for (t = 0; t < 2000000000ull; t += 2000000)
+			add_event(200, t, rnd_sector(&seed, 4096), 4096, 0, 1);
+	} else {
+		fprintf(stderr, "unknown workload %s\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+static void *stream_fn(void *arg)
+{
+	struct stream *s = arg;
+	uint64_t start = ts_ns(&start_ts), t0, now;
+	struct timespec ts;
+	void *buf;
+	int i;
+
+	if (posix_memalign(&buf, 4096, MAX_IO_BYTES))
+		return NULL;
+	memset(buf, 0x5a, MAX_IO_BYTES);
+
+	for (i = 0; i < s->nr; i++) {
+		struct io_event *ev = &s->ev[i];
+		off_t off = (off_t)(ev->sector % dev_sectors) * SECTOR_SIZE;
+		ssize_t ret;
+
+		now = now_ns();
+		if (now < start + ev->time_ns) {
+			uint64_t wake = start + ev->time_ns;
+
+			ts.tv_sec = wake / 1000000000ull;
+			ts.tv_nsec = wake % 1000000000ull;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		}
+
+		if ((uint64_t)off + ev->bytes > dev_sectors * SECTOR_SIZE)
+			off = 0;
+
+		t0 = now_ns();
+		if (ev->write)
+			ret = pwrite(ev->sync ? dev_fd : buf_fd, buf,
+				     ev->bytes, off);
+		else
+			ret = pread(dev_fd, buf, ev->bytes, off);
+		ev->lat_ns = now_ns() - t0;
+		if (ret != (ssize_t)ev->bytes)
+			ev->lat_ns = 0;
+	}
+
+	free(buf);
+	return NULL;
+}
+
+static int set_scheduler(const char *sched)
+{
+	char path[256], cur[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/block/%s/queue/scheduler", dev_name);
+	f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	fprintf(f, "%s", sched);
+	if (fclose(f))
+		return -1;
+
+	/* the write succeeds for unknown names, check what got selected */
+	f = fopen(path, "r");
+	if (!f || !fgets(cur, sizeof(cur), f)) {
+		if (f)
+			fclose(f);
+		return -1;
+	}
+	fclose(f);
+	snprintf(path, sizeof(path), "[%s]", sched);
+	return strstr(cur, path) ? 0 : -1;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double pct_us(uint64_t *v, int n, double p)
+{
+	int i;
+
+	if (!n)
+		return 0;
+	i = (int)(p * (n - 1) / 100.0 + 0.5);
+	return v[i] / 1000.0;
+}
+
+static void report(const char *sched, uint64_t wall_ns)
+{
+	uint64_t *lat[2];
+	int n[2] = { 0, 0 }, total = 0, i, j, d, m;
+	double bytes = 0, sum = 0, sum2 = 0, mean;
+	uint64_t slat;
+
+	for (i = 0; i < nr_streams; i++)
+		total += streams[i].nr;
+	lat[0] = malloc(total * sizeof(uint64_t));
+	lat[1] = malloc(total * sizeof(uint64_t));
+	if (!lat[0] || !lat[1]) {
+		perror("malloc");
+		exit(1);
+	}
+
+	for (i = 0, m = 0; i < nr_streams; i++) {
+		slat = 0;
+		d = 0;
+		for (j = 0; j < streams[i].nr; j++) {
+			struct io_event *ev = &streams[i].ev[j];
+
+			if (!ev->lat_ns)
+				continue;
+			lat[ev->write][n[ev->write]++] = ev->lat_ns;
+			bytes += ev->bytes;
+			slat += ev->lat_ns;
+			d++;
+		}
+		if (d) {
+			mean = (double)slat / d;
+			sum += mean;
+			sum2 += mean * mean;
+			m++;
+		}
+	}
+
+	for (d = 0; d < 2; d++)
+		qsort(lat[d], n[d], sizeof(uint64_t), cmp_u64);
+
+	printf("%-11s %8.0f %8.0f %8.0f %9.0f %8.0f %8.0f %8.1f %6.3f\n",
+	       sched,
+	       pct_us(lat[0], n[0], 50), pct_us(lat[0], n[0], 99),
+	       pct_us(lat[0], n[0], 99.9), n[0] ? lat[0][n[0] - 1] / 1000.0 : 0,
+	       pct_us(lat[1], n[1], 50), pct_us(lat[1], n[1], 99),
+	       bytes / (wall_ns / 1e9) / (1024 * 1024),
+	       sum2 ? sum * sum / (m * sum2) : 1.0);
+
+	free(lat[0]);
+	free(lat[1]);
+}
+
+static int run_one(const char *sched)
+{
+	uint64_t t0;
+	int i;
+
+	if (set_scheduler(sched)) {
+		printf("%-11s (not available)\n", sched);
+		return -1;
+	}
+
+	fsync(buf_fd);
+	ioctl(dev_fd, BLKFLSBUF, 0);
+	clock_gettime(CLOCK_MONOTONIC, &start_ts);
+	/* give the threads a moment to start before the first event */
+	start_ts.tv_nsec += 10000000;
+	if (start_ts.tv_nsec >= 1000000000) {
+		start_ts.tv_sec++;
+		start_ts.tv_nsec -= 1000000000;
+	}
+
+	t0 = ts_ns(&start_ts);
+	for (i = 0; i < nr_streams; i++)
+		if (pthread_create(&streams[i].thread, NULL, stream_fn, &streams[i])) {
+			perror("pthread_create");
+			exit(1);
+		}
+	for (i = 0; i < nr_streams; i++)
+		pthread_join(streams[i].thread, NULL);
+	fsync(buf_fd);
+
+	report(sched, now_ns() - t0);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -d <dev> [-s sched,...]\n"
+		"          [-t blkparse.txt | -w applaunch|camera|bgsync]\n"
+		"          [-r runs] [-l max_streams]\n"
+		"  default schedulers: " DEFAULT_SCHEDS "\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	char *scheds = strdup(DEFAULT_SCHEDS), *sched_list[32], *save;
+	const char *trace = NULL, *workload = "applaunch";
+	char path[256];
+	int runs = 1, nr_scheds = 0, c, r, i;
+
+	while ((c = getopt(argc, argv, "d:s:t:w:r:l:h")) != -1) {
+		switch (c) {
+		case 'd':
+			dev_name = optarg;
+			if (!strncmp(dev_name, "/dev/", 5))
+				dev_name += 5;
+			break;
+		case 's':
+			free(scheds);
+			scheds = strdup(optarg);
+			break;
+		case 't':
+			trace = optarg;
+			break;
+		case 'w':
+			workload = optarg;
+			break;
+		case 'r':
+			runs = atoi(optarg);
+			break;
+		case 'l':
+			max_streams = atoi(optarg);
+			if (max_streams < 1 || max_streams > MAX_STREAMS)
+				max_streams = MAX_STREAMS;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!dev_name)
+		usage(argv[0]);
+
+	snprintf(path, sizeof(path), "/dev/%s", dev_name);
+	dev_fd = open(path, O_RDWR | O_DIRECT);
+	if (dev_fd < 0) {
+		perror(path);
+		return 1;
+	}
+	buf_fd = open(path, O_RDWR);
+	if (buf_fd < 0) {
+		perror(path);
+		return 1;
+	}
+	if (ioctl(dev_fd, BLKGETSIZE64, &dev_sectors)) {
+		perror("BLKGETSIZE64");
+		return 1;
+	}
+	dev_sectors /= SECTOR_SIZE;
+	if (dev_sectors < 2 * MAX_IO_BYTES / SECTOR_SIZE) {
+		fprintf(stderr, "%s is too small\n", path);
+		return 1;
+	}
+
+	if (trace ? load_trace(trace) : gen_workload(workload))
+		return 1;
+
+	printf("%d streams, %s\n", nr_streams, trace ? trace : workload);
+	printf("%-11s %8s %8s %8s %9s %8s %8s %8s %6s\n", "scheduler",
+	       "rd p50", "rd p99", "rd p99.9", "rd max", "wr p50", "wr p99",
+	       "MB/s", "fair");
+	printf("%-11s %8s %8s %8s %9s %8s %8s\n", "", "(us)", "(us)", "(us)",
+	       "(us)", "(us)", "(us)");
+
+	for (sched_list[0] = strtok_r(scheds, ",", &save);
+	     sched_list[nr_scheds] && nr_scheds < 31;
+	     sched_list[nr_scheds] = strtok_r(NULL, ",", &save))
+		nr_scheds++;
+
+	for (r = 0; r < runs; r++)
+		for (i = 0; i < nr_scheds; i++)
+			run_one(sched_list[i]);
+
+	close(buf_fd);
+	close(dev_fd);
+	free(scheds);
+	return 0;
+}